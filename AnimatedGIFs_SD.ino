@@ -6,12 +6,30 @@
 #define min(a, b) (((a) <= (b)) ? (a) : (b))
 #endif
 #include "GifDecoder.h"
+#include "GifExpand.h"       //.kbv palette lookup kernels
+#include "GifStream.h"       //.kbv .GFS files made by tools/gif2stream
+#include "GifPack.h"         //.kbv many GIFs in one file made by tools/gifpack
 #include "FilenameFunctions.h"    //defines USE_SPIFFS
 
 #define DISPLAY_TIME_SECONDS 100  //
 #define NUMBER_FULL_CYCLES     3  //
 #define GIFWIDTH             480  //228 fails on COW_PAINT.  Edit class_implementation.cpp
+#define GIFHEIGHT            320  //
 #define FLASH_SIZE      512*1024  //     
+#define FRAME_DIFF             0  //1: only draw pixels that changed.  needs GIFWIDTH*GIFHEIGHT*2 bytes heap
+#define SCALE_TO_FIT           0  //1: shrink big GIFs to the panel.  2: with 2x2 box filter
+#define GIF_ROTATION           0  //quarter turns done by the decoder for panels that can't rotate
+#define BLOCK_LINES            0  //rows sent in one window by drawBlockCallback.  GIFWIDTH*BLOCK_LINES*2 bytes RAM.  0: one window per row
+#define PROGRESSIVE            0  //1: opaque interlaced GIFs show a coarse picture after the first pass
+#define DISPLAY_GAMMA          0  //e.g. 2.2 for LED panels.  applied to each palette, not each pixel
+#define WIRE_ORDER             0  //1: decoder makes big-endian 565.  pushColors(..., bigend) sends it without swapping
+#define DASHBOARD              0  //1: three flash GIFs play at once with GifCompositor.  about 110kB RAM, 88kB of it layer images
+#define FRAME_CACHE            0  //bytes of heap (PSRAM if fitted) to replay loops after the first.  e.g. 2000000
+#define FRAME_CACHE_LIST       1  //1: cache palette indices, about half the size.  0: cache display pixels
+#define SD_CACHE               0  //bytes of SD card for cache files that replay GIFs on later visits.  e.g. 64000000
+                                  //FRAME_CACHE is then one chunk of the file, e.g. 16384
+#define GIF_PACK               0  //1: play GIF_PACK_FILE from SD if it is there.  2: gif_pack.h (gifpack -h) in flash instead of gifs[]
+#define GIF_PACK_FILE "/gifs.gpk"
 
 /*  template parameters are maxGifWidth, maxGifHeight, lzwMaxBits
 
@@ -20,7 +38,22 @@
     All 32x32-pixel GIFs tested work with 11, most work with 10
 */
 
-GifDecoder<GIFWIDTH, 320, 12> decoder;
+#define LZW_BITS              12  //tools/gif2header lists the bits each GIF needs.  class_implement.cpp must match
+GifDecoder<GIFWIDTH, GIFHEIGHT, LZW_BITS> decoder;
+#if DASHBOARD
+#include "GifCompositor.h"
+GifCompositor<128, 128, 3> dashboard;  //.kbv layers up to 128x128.  class_implement.cpp must match
+#endif
+uint16_t *composite;  //.kbv previous frame for FRAME_DIFF
+#if SCALE_TO_FIT == 2
+uint8_t boxRow[GIFWIDTH];  //.kbv box filter holds one GIF row back
+#else
+uint8_t *const boxRow = NULL;
+#endif
+GifStreamPlayer player;  //.kbv .GFS files.  #define GIF_STREAMS in FilenameFunctions.h
+bool streaming;          //.kbv the player has the current file, not the decoder
+GifPack pack;            //.kbv GIF_PACK
+bool packed;             //.kbv files come from the pack, not the directory or gifs[]
 
 #if defined(USE_SPIFFS)
 #define GIF_DIRECTORY "/"     //ESP8266 SPIFFS
@@ -34,6 +67,21 @@ GifDecoder<GIFWIDTH, 320, 12> decoder;
 
 #include "USE_TFT_LIB.h"
 
+#if SD_CACHE && !FRAME_CACHE
+#error SD_CACHE reads and writes through the FRAME_CACHE buffer
+#endif
+#if (GIF_ROTATION & 1) && !BLOCK_LINES
+#error GIF_ROTATION 1 and 3 send turned rows as blocks.  Set BLOCK_LINES too
+#endif
+
+#if GIF_ROTATION & 1
+#define VIEW_WIDTH  tft.height()  //decoder turns landscape GIFs onto the portrait panel
+#define VIEW_HEIGHT tft.width()
+#else
+#define VIEW_WIDTH  tft.width()
+#define VIEW_HEIGHT tft.height()
+#endif
+
 // Assign human-readable names to some common 16-bit color values:
 #define BLACK   0x0000
 #define BLUE    0x001F
@@ -51,18 +99,25 @@ long skipCount; //.kbv
 long lineTime;  //.kbv
 int32_t parse_start; //.kbv
 
+#if GIF_PACK == 2
+#include "gif_pack.h"   //one PROGMEM array gif_pack[]
+#endif
+#if GIF_PACK != 2 || DASHBOARD
 #include "gifs_128.h"
 #include "wrong_gif.h"
 #include "llama_gif.h"
 #include "mad_man_gif.h"
 #include "mad_race_gif.h"
+#endif
 
 
-#define M0(x) {x, #x, sizeof(x)}
+#if GIF_PACK != 2
+#define M0(x) {x, #x, sizeof(x), &x##_info}   //.kbv headers made by tools/gif2header
 typedef struct {
     const unsigned char *data;
     const char *name;
     uint32_t sz;
+    const gif_info_t *info;  //.kbv size, frames and loop time without parsing
 } gif_detail_t;
 gif_detail_t gifs[] = {
 #if FLASH_SIZE >= 1024 * 1024      //Teensy4.0, ESP32, F767, L476
@@ -97,6 +152,7 @@ gif_detail_t gifs[] = {
     M0(horse_128x96x8_gif),        //  7868
 #endif
 };
+#endif
 
 const uint8_t *g_gif;
 uint32_t g_seek;
@@ -123,19 +179,63 @@ void screenClearCallback(void) {
     //    tft.fillRect(0, 0, 128, 128, 0x0000);
 }
 
+#if GIF_PACK != 2
 bool openGifFilenameByIndex_P(const char *dirname, int index)
 {
     gif_detail_t *g = &gifs[index];
     g_gif = g->data;
     g_seek = 0;
 
-    Serial.print("Flash: ");
-    Serial.print(g->name);
-    Serial.print(" size: ");
-    Serial.println(g->sz);
+    char buf[80];
+    const gif_info_t *info = g->info;
+    sprintf(buf, "Flash: %s %dx%d %d frames %ldms size: %ld", g->name,
+            info->width, info->height, info->frameCount, (long)info->loopTime, (long)g->sz);
+    Serial.println(buf);
+    if (info->lzwBits > LZW_BITS)
+        Serial.println("LZW codes wider than LZW_BITS.  Expect garbage");
 
     return index < num_files;
 }
+#endif
+
+// .kbv a pack is read through its own callbacks.  Opening a GIF is a seek, not a directory walk
+void usePack(void) {
+    packed = true;
+    decoder.setFileSeekCallback(GifPack::fileSeekCallback);
+    decoder.setFilePositionCallback(GifPack::filePositionCallback);
+    decoder.setFileReadCallback(GifPack::fileReadCallback);
+    decoder.setFileReadBlockCallback(GifPack::fileReadBlockCallback);
+    player.setFileSeekCallback(GifPack::fileSeekCallback);
+    player.setFileReadBlockCallback(GifPack::fileReadBlockCallback);
+    gif_pack_entry e;
+    for (int i = 0; pack.getEntry(i, &e); i++) {
+        char buf[80];
+        sprintf(buf, "%d:%s %dx%d %d frames %ldms size:%ld", i + 1, e.name,
+                e.width, e.height, e.frameCount, (long)e.loopTime, (long)e.size);
+        Serial.println(buf);
+    }
+}
+
+bool openGifPackByIndex(int index) {
+    gif_pack_entry e;
+    if (!pack.getEntry(index, &e) || !pack.select(index))
+        return false;
+    Serial.print("Pack: ");
+    Serial.println(e.name);
+    return true;
+}
+#if SD_CACHE
+// .kbv anything that changes what the decoder sends.  Cache files made with other settings are recorded again
+unsigned long cacheSettings(void) {
+    long v[] = { FRAME_CACHE, FRAME_CACHE_LIST, composite != NULL, SCALE_TO_FIT, GIF_ROTATION, BLOCK_LINES,
+                 PROGRESSIVE, (long)(DISPLAY_GAMMA * 100), WIRE_ORDER, FILL_MIN_RUN, tft.width(), tft.height()
+               };
+    unsigned long h = 2166136261UL;
+    for (int i = 0; i < sizeof(v) / sizeof(*v); i++) h = (h ^ v[i]) * 16777619UL;
+    return h;
+}
+#endif
+
 void updateScreenCallback(void) {
     ;
 }
@@ -146,9 +246,19 @@ void drawPixelCallback(int16_t x, int16_t y, uint8_t red, uint8_t green, uint8_t
     rowCount = 1;
 }
 
+#if GIF_PIXEL_FORMAT != GIF_RGB565
+#error these callbacks push 565 pixels.  Write pushPixels() etc for your panel's GIF_PIXEL_FORMAT
+#endif
+
+void pushPixels(uint16_t *buf565, int16_t n) {
+#if WIRE_ORDER
+    tft.pushColors((const uint8_t *)buf565, n, true, true);
+#else
+    tft.pushColors(buf565, n, true);
+#endif
+}
+
 void drawLineCallback(int16_t x, int16_t y, uint8_t *buf, int16_t w, uint16_t *palette, int16_t skip) {
-    uint8_t pixel;
-    bool first;
     int32_t t = micros();
     if (y >= tft.height() || x >= tft.width() ) return;
     if (x + w > tft.width()) w = tft.width() - x;
@@ -156,19 +266,15 @@ void drawLineCallback(int16_t x, int16_t y, uint8_t *buf, int16_t w, uint16_t *p
     int16_t endx = x + w - 1;
     uint16_t buf565[w];
     for (int i = 0; i < w; ) {
-        int n = 0;
-        while (i < w) {
-            pixel = buf[i++];
-            if (pixel == skip) {
-                skipCount++;
-                break;
-            }
-            buf565[n++] = palette[pixel];
-        }
+        int gap = gifRunLength(buf + i, w - i, skip, false);
+        skipCount += gap;
+        i += gap;
+        int n = gifRunLength(buf + i, w - i, skip, true);
         if (n) {
-            tft.setAddrWindow(x + i - n, y, endx, y);
-            first = true;
-            tft.pushColors(buf565, n, first);
+            gifExpand(buf565, buf + i, n, palette);
+            tft.setAddrWindow(x + i, y, endx, y);
+            pushPixels(buf565, n);
+            i += n;
         }
     }
     plotCount += w;  //count total pixels (including skipped)
@@ -176,6 +282,62 @@ void drawLineCallback(int16_t x, int16_t y, uint8_t *buf, int16_t w, uint16_t *p
     lineTime += micros() - t;
 }
 
+void fillRectCallback(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    int32_t t = micros();
+    if (y >= tft.height() || x >= tft.width() ) return;
+    if (x + w > tft.width()) w = tft.width() - x;
+    if (y + h > tft.height()) h = tft.height() - y;
+    if (w <= 0 || h <= 0) return;
+    tft.fillRect(x, y, w, h, color);
+    lineTime += micros() - t;
+}
+
+void drawRowCallback(int16_t x, int16_t y, uint16_t *buf565, int16_t w) {
+    int32_t t = micros();
+    if (y >= tft.height() || x >= tft.width() ) return;
+    if (x + w > tft.width()) w = tft.width() - x;
+    if (w <= 0) return;
+    tft.setAddrWindow(x, y, x + w - 1, y);
+    pushPixels(buf565, w);
+    plotCount += w;
+    rowCount += 1;
+    lineTime += micros() - t;
+}
+
+void drawBlockCallback(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t *buf565) {
+    int32_t t = micros();
+    if (y + h > tft.height() || x + w > tft.width() ) {   //clipped blocks go a row at a time
+        for (int i = 0; i < h; i++) drawRowCallback(x, y + i, buf565 + i * w, w);
+        return;
+    }
+    tft.setAddrWindow(x, y, x + w - 1, y + h - 1);
+    pushPixels(buf565, w * h);
+    plotCount += w * h;
+    rowCount += 1;
+    lineTime += micros() - t;
+}
+
+#if defined(GIF_STREAMS)
+// .kbv streams are made for the panel (gif2stream -s, -r) so windows need no clipping
+#define STREAM_BUFFER 4096   //two of these.  a multiple of the stream's alignment
+uint8_t streamBuffers[2][STREAM_BUFFER] __attribute__((aligned(4)));
+bool streamFirst;
+
+void streamWindowCallback(int16_t x, int16_t y, int16_t w, int16_t h) {
+    tft.setAddrWindow(x, y, x + w - 1, y + h - 1);
+    streamFirst = true;
+    rowCount += 1;
+}
+
+void streamPushCallback(uint8_t *bytes, int count) {
+    int32_t t = micros();
+    tft.pushColors(bytes, count / 2, streamFirst, true);  //big-endian 565
+    streamFirst = false;
+    plotCount += count / 2;
+    lineTime += micros() - t;
+}
+#endif
+
 // Setup method runs once, when the sketch starts
 void setup() {
     char msg[80];
@@ -183,12 +345,57 @@ void setup() {
     while (!Serial) ;
     Serial.println("\nAnimatedGIFs_SD");
     tft.begin(tft.readID());
-    tft.setRotation(1);
+    tft.setRotation(GIF_ROTATION ? 0 : 1);
     tft.fillScreen(BLACK);
     decoder.setScreenClearCallback(screenClearCallback);
     decoder.setUpdateScreenCallback(updateScreenCallback);
     decoder.setDrawPixelCallback(drawPixelCallback);
     decoder.setDrawLineCallback(drawLineCallback);
+#if SCALE_TO_FIT == 2 || GIF_ROTATION
+    decoder.setDrawRowCallback(drawRowCallback);  //box filter and turns need 565 rows
+#endif
+    decoder.setWireOrder(WIRE_ORDER);
+    decoder.setProgressive(PROGRESSIVE);
+#if DISPLAY_GAMMA
+    static uint8_t gamma[256];
+    for (int i = 0; i < 256; i++) gamma[i] = 255 * pow(i / 255.0, DISPLAY_GAMMA) + 0.5;
+    decoder.setGammaTable(gamma);
+#endif
+#if BLOCK_LINES
+    static uint16_t blockBuf[GIFWIDTH * BLOCK_LINES];  //narrower rows fit more than BLOCK_LINES
+    decoder.setDrawBlockCallback(drawBlockCallback, blockBuf, BLOCK_LINES);
+    decoder.setBlockLines(BLOCK_LINES);
+#endif
+#if GIF_ROTATION & 1
+    static uint16_t tileBuf[GIF_TILE_PIXELS(GIFWIDTH, ROTATE_TILE_ROWS)];  //8 output rows are turned at a time
+    decoder.setTileBuffer(tileBuf, ROTATE_TILE_ROWS);
+#endif
+    decoder.setOrientation(GIF_ROTATION);  //after the sinks and buffers it needs
+#if DASHBOARD
+    dashboard.setCanvas(tft.width(), tft.height(), BLACK);
+    dashboard.setWireOrder(WIRE_ORDER);
+    dashboard.setDrawRowCallback(drawRowCallback);
+    static uint16_t teakettleImage[128 * 128], bottomImage[128 * 128], horseImage[128 * 96];  //each GIF's screen
+    dashboard.addLayer(teakettle_128x128x10_gif, sizeof(teakettle_128x128x10_gif), teakettleImage, 128 * 128, 16, 16);
+    dashboard.addLayer(bottom_128x128x17_gif, sizeof(bottom_128x128x17_gif), bottomImage, 128 * 128, 112, 80, 1);  //in front
+    dashboard.addLayer(horse_128x96x8_gif, sizeof(horse_128x96x8_gif), horseImage, 128 * 96, 288, 40);
+#endif
+    decoder.setFillRectCallback(fillRectCallback);
+    decoder.setFillThreshold(FILL_MIN_RUN);
+    decoder.setViewport(0, 0, VIEW_WIDTH, VIEW_HEIGHT);  //don't decode what the panel can't show
+#if FRAME_DIFF
+    composite = (uint16_t *)malloc(GIFWIDTH * GIFHEIGHT * sizeof(uint16_t));
+    if (composite == NULL) Serial.println("No RAM for FRAME_DIFF");
+#endif
+#if FRAME_CACHE
+#if defined(BOARD_HAS_PSRAM)
+    uint8_t *cache = (uint8_t *)ps_malloc(FRAME_CACHE);
+#else
+    uint8_t *cache = (uint8_t *)malloc(FRAME_CACHE);
+#endif
+    if (cache == NULL) Serial.println("No RAM for FRAME_CACHE");
+    decoder.setFrameCache(cache, FRAME_CACHE, FRAME_CACHE_LIST);  //GIFs that don't fit are decoded every loop
+#endif
 
     int ret = initSdCard(SD_CS);
     if (ret == 0) {
@@ -196,12 +403,30 @@ void setup() {
         decoder.setFilePositionCallback(filePositionCallback);
         decoder.setFileReadCallback(fileReadCallback);
         decoder.setFileReadBlockCallback(fileReadBlockCallback);
-        num_files = enumerateGIFFiles(GIF_DIRECTORY, true);
+#if defined(GIF_STREAMS)
+        player.setBuffers(streamBuffers[0], streamBuffers[1], STREAM_BUFFER);
+        player.setFileSeekCallback(fileSeekCallback);
+        player.setFileReadBlockCallback(fileReadBlockCallback);
+        player.setWindowCallback(streamWindowCallback);
+        player.setPushCallback(streamPushCallback);
+        player.setFillRectCallback(fillRectCallback);
+#endif
+#if GIF_PACK == 1
+        if (openPackFile(GIF_PACK_FILE) && (num_files = pack.open(fileSeekCallback, fileReadBlockCallback)) > 0)
+            usePack();
+        else
+#endif
+            num_files = enumerateGIFFiles(GIF_DIRECTORY, true);
     }
     if (ret != 0 || num_files == 0) {
         if (num_files == 0) sprintf(msg, "No GIF files on SD card");
         else sprintf(msg, "No SD card on CS:%d", SD_CS);
         Serial.println(msg);
+#if GIF_PACK == 2
+        g_gif = gif_pack;
+        num_files = pack.open(gif_pack);
+        usePack();
+#else
         decoder.setFileSeekCallback(fileSeekCallback_P);
         decoder.setFilePositionCallback(filePositionCallback_P);
         decoder.setFileReadCallback(fileReadCallback_P);
@@ -210,6 +435,7 @@ void setup() {
         for (num_files = 0; num_files < sizeof(gifs) / sizeof(*gifs); num_files++) {
             Serial.println(gifs[num_files].name);
         }
+#endif
     }
 
     sprintf(msg, "Animated GIF files Found: %d", num_files);
@@ -225,15 +451,22 @@ void setup() {
 void loop() {
     static unsigned long futureTime, cycle_start, nextFrameTime, frame_time, frames;
 
+#if DASHBOARD
+    dashboard.update();  //draws whatever is due.  returns ms to the next frame
+    yield();
+    return;
+#endif
+
     //    int index = random(num_files);
     static int index = -1;
 
     int32_t now = millis();
-    if (now >= futureTime || decoder.getCycleNo() > NUMBER_FULL_CYCLES) {
+    int cycleNo = streaming ? player.getCycleNo() : decoder.getCycleNo();
+    if (now >= futureTime || cycleNo > NUMBER_FULL_CYCLES) {
         char buf[100];
-        int32_t frameCount = decoder.getFrameCount();
+        int32_t frameCount = streaming ? player.getFrameCount() : decoder.getFrameCount();
         if (frameCount > 0) {   //complete animation sequence
-            int32_t framedelay = decoder.getFrameDelay_ms();
+            int32_t framedelay = streaming ? player.getFrameDelay_ms() : decoder.getFrameDelay_ms();
             int32_t cycle_design = framedelay * frameCount;
             int32_t cycle_time = now - cycle_start;
             int32_t percent = (100 * cycle_design) / cycle_time;
@@ -252,7 +485,17 @@ void loop() {
             char ft[10], dt[10];
             dtostrf(frame_time * map, 5, 1, ft);
             dtostrf(lineTime * map, 5, 1, dt);
-            sprintf(buf, "avg:%sms draw:%sms %d%%", ft, dt, skipcent);
+            sprintf(buf, "avg:%sms draw:%sms %d%% fill:%ld=%ldkB", ft, dt, skipcent,
+                    decoder.getFillCount(), decoder.getFillBytesSaved() / 1024);
+            if (streaming) sprintf(buf, "avg:%sms draw:%sms stream", ft, dt);
+            Serial.print(buf);
+            buf[0] = 0;
+            if (composite && decoder.getDiffPixels()) {
+                int32_t samecent = (100.0 * decoder.getDiffSkipped()) / decoder.getDiffPixels();
+                sprintf(buf, " same:%d%%", samecent);
+            }
+            if (decoder.isReplaying())
+                sprintf(buf + strlen(buf), " cache:%ldkB", decoder.getCacheUsed() / 1024);
             Serial.println(buf);
         }
         skipCount = plotCount = rowCount = lineTime = frames = frame_time = 0L;
@@ -265,26 +508,60 @@ void loop() {
             index = 0;
         }
 
-        int good;
-        if (g_gif) good = (openGifFilenameByIndex_P(GIF_DIRECTORY, index) >= 0);
+        bool good;
+        bool stream;
+        gif_pack_entry e;
+        if (packed) {
+            good = openGifPackByIndex(index);
+            stream = pack.getEntry(index, &e) && (e.flags & GIF_PACK_STREAM);
+        }
+#if GIF_PACK != 2
+        else if (g_gif) good = openGifFilenameByIndex_P(GIF_DIRECTORY, index);
+#endif
         else good = (openGifFilenameByIndex(GIF_DIRECTORY, index) >= 0);
-        if (good >= 0) {
+        if (!packed) stream = !g_gif && isStreamOpen();
+        streaming = good && stream && player.startPlaying() >= 0;
+        if (streaming) {
+            tft.fillScreen(BLACK);  //the intro only covers the stream's area
+        } else if (good) {
             tft.fillScreen(g_gif ? MAGENTA : DISKCOLOUR);
-            tft.fillRect(GIFWIDTH, 0, 1, tft.height(), WHITE);
-            tft.fillRect(278, 0, 1, tft.height(), WHITE);
+            if (composite) decoder.setCompositeBuffer(composite, g_gif ? MAGENTA : DISKCOLOUR);
+            else {
+                tft.fillRect(GIFWIDTH, 0, 1, tft.height(), WHITE);
+                tft.fillRect(278, 0, 1, tft.height(), WHITE);
+            }
 
+#if SD_CACHE
+            int cached = (g_gif || packed) ? -1 : openCacheFile(cacheSettings(), SD_CACHE);
+            if (cached < 0) decoder.setCacheFile(NULL, NULL, NULL, 0, false);
+            else decoder.setCacheFile(cacheSeekCallback, cacheReadCallback, cacheWriteCallback, CACHE_FILE_START, cached);
+#endif
             decoder.startDecoding();
+#if GIF_PACK != 2
+            if (g_gif && !packed) decoder.setGifInfo(gifs[index].info);  //frame count before loop 1 ends, restart points for seekToFrame()
+#endif
+#if SCALE_TO_FIT
+            // keep the aspect ratio.  GIFs that fit are not scaled
+            int32_t gw = decoder.getLogicalWidth(), gh = decoder.getLogicalHeight();
+            if (gw <= VIEW_WIDTH && gh <= VIEW_HEIGHT)
+                decoder.setOutputSize(0, 0);
+            else if (gw * VIEW_HEIGHT > gh * VIEW_WIDTH)
+                decoder.setOutputSize(VIEW_WIDTH, gh * VIEW_WIDTH / gw, boxRow);
+            else
+                decoder.setOutputSize(gw * VIEW_HEIGHT / gh, VIEW_HEIGHT, boxRow);
+#endif
 
         }
     }
 
     parse_start = micros();
-    decoder.decodeFrame();
+    if (streaming) player.playFrame();
+    else decoder.decodeFrame();
     yield();
     frame_time += micros() - parse_start; //count it even if housekeeping block
-    if (decoder.getFrameNo() != 0) {  //don't count the header blocks.
+    if ((streaming ? player.getFrameNo() : decoder.getFrameNo()) != 0) {  //don't count the header blocks.
         frames++;
-        nextFrameTime = now + decoder.getFrameDelay_ms();
+        nextFrameTime = now + (streaming ? player.getFrameDelay_ms() : decoder.getFrameDelay_ms());
         while (millis() <= nextFrameTime) yield();
     }
     yield();
@@ -7,6 +7,9 @@
 */
 
 #include "FilenameFunctions.h"    //defines USE_SPIFFS as reqd
+#if defined(GIF_CATALOG) && defined(GIF_STREAMS)
+#include "GifStream.h"
+#endif
 
 #if defined (ARDUINO)
 #ifdef USE_SPIFFS
@@ -27,9 +30,18 @@
 #endif
 
 File file;
+bool streamOpen;
 
 int numberOfFiles;
 
+// .kbv names packed end to end with their offsets.  Filled in one pass with no heap
+#if GIF_INDEX_POOL > 0
+char indexPool[GIF_INDEX_POOL];
+uint16_t indexOffset[GIF_INDEX_FILES];
+int indexUsed, indexCount;          // bytes, names
+char indexDirectory[32];
+#endif
+
 bool fileSeekCallback(unsigned long position) {
 #ifdef USE_SPIFFS
     return file.seek(position, SeekSet);
@@ -70,6 +82,18 @@ int initSdCard(int chipSelectPin) {
     return 0;
 }
 
+// suffix is upper case
+bool hasSuffix(const char *name, const char *suffix) {
+    int len = strlen(name), n = strlen(suffix);
+    if (len < n)
+        return false;
+    for (name += len - n; *suffix; name++, suffix++) {
+        if (toupper(*name) != *suffix)
+            return false;
+    }
+    return true;
+}
+
 bool isAnimationFile(const char filename []) {
     if (filename[0] == '_')
         return false;
@@ -80,19 +104,291 @@ bool isAnimationFile(const char filename []) {
     if (filename[0] == '.')
         return false;
 
-    String filenameString = String(filename);   //.kbv STM32 and ESP need separate statements
-    filenameString.toUpperCase();
-    if (filenameString.endsWith(".GIF") != 1)
-        return false;
+    if (hasSuffix(filename, ".GIF"))    //.kbv no String on the heap for every entry
+        return true;
+#ifdef GIF_STREAMS
+    if (hasSuffix(filename, ".GFS"))
+        return true;
+#endif
+
+    return false;
+}
+
+// Name without its directory
+const char *baseName(const char *path) {
+    const char *name = strrchr(path, '/');    //.kbv some cores give the whole path
+    return name ? name + 1 : path;
+}
 
+// Directory and name joined for opening.  false = longer than GIF_PATH_MAX, and pnBuffer is ""
+bool joinPath(char *pnBuffer, const char *directoryName, const char *filename) {
+    int len = strlen(directoryName);
+    const char *slash = (len == 0 || directoryName[len - 1] != '/') ? "/" : "";
+    if (filename[0] == '/') {
+        directoryName = slash = "";     //.kbv ESP32 and SPIFFS names can already be the whole path
+        len = 0;
+    }
+    if (len + strlen(slash) + strlen(filename) >= GIF_PATH_MAX) {
+        pnBuffer[0] = 0;
+        return false;
+    }
+    strcpy(pnBuffer, directoryName);
+    strcat(pnBuffer, slash);
+    strcat(pnBuffer, filename);
     return true;
 }
 
+bool isStreamOpen(void) {
+    return streamOpen;
+}
+
+// Directory catalog.  enumerateGIFFiles() walks the directory once comparing names and
+// sizes with the catalog.  Only new or changed files are probed, and the catalog is only
+// written when something changed.  Opening file N then reads record N and opens its name
+// .kbv the Arduino SD library can't rename, so a new catalog is written beside the old
+//   one and copied over it.  A catalog without its trailer is ignored and rebuilt
+#if defined(GIF_CATALOG) && !defined(USE_SPIFFS)
+typedef struct catalog_header {
+    char magic[4];          // "GCT1"
+    uint16_t recordSize;
+    uint16_t pad;
+} catalog_header;
+
+typedef struct catalog_trailer {
+    char magic[4];          // "GCT!"
+    uint32_t count;
+} catalog_trailer;
+
+File catalogFile;           // open for reading records
+int catalogCount;           // 0 = no catalog
+char catalogDirectory[32];
+
+// Records in a valid catalog.  -1 = none.  catalogFile stays open
+int openCatalog(const char *path) {
+    catalog_header head;
+    catalog_trailer tail;
+    if (catalogFile)
+        catalogFile.close();
+    catalogCount = 0;
+    catalogFile = SD.open(path);
+    if (!catalogFile)
+        return -1;
+    unsigned long length = catalogFile.size();
+    bool good = length >= sizeof(head) + sizeof(tail)
+                && catalogFile.read((uint8_t *)&head, sizeof(head)) == sizeof(head)
+                && memcmp(head.magic, "GCT1", 4) == 0 && head.recordSize == sizeof(gif_catalog_entry)
+                && catalogFile.seek(length - sizeof(tail))
+                && catalogFile.read((uint8_t *)&tail, sizeof(tail)) == sizeof(tail)
+                && memcmp(tail.magic, "GCT!", 4) == 0
+                && length == sizeof(head) + tail.count * sizeof(gif_catalog_entry) + sizeof(tail);
+    if (!good) {
+        catalogFile.close();
+        return -1;
+    }
+    catalogCount = tail.count;
+    return catalogCount;
+}
+
+bool readCatalog(int index, gif_catalog_entry *entry) {
+    if (index < 0 || index >= catalogCount)
+        return false;
+    return catalogFile.seek(sizeof(catalog_header) + (unsigned long)index * sizeof(gif_catalog_entry))
+           && catalogFile.read((uint8_t *)entry, sizeof(gif_catalog_entry)) == sizeof(gif_catalog_entry);
+}
+
+// .kbv follows the blocks without LZW.  Delays as the decoder times them
+void probeFile(File &f, gif_catalog_entry *e) {
+    uint8_t b[16];
+    unsigned long pos = 0, length = f.size();
+    int delay = 0;
+    f.seek(0);
+#ifdef GIF_STREAMS
+    gif_stream_header h;
+    if (f.read((uint8_t *)&h, sizeof(h)) == sizeof(h) && memcmp(h.magic, GIF_STREAM_MAGIC, 4) == 0) {
+        e->width = h.width;
+        e->height = h.height;
+        e->frameCount = h.frameCount;
+        e->loopTime = h.loopTime;
+        e->flags = CATALOG_STREAM;
+        return;
+    }
+    f.seek(0);
+#endif
+    if (f.read(b, 13) != 13 || memcmp(b, "GIF8", 4) != 0)
+        return;
+    e->width = b[6] | (b[7] << 8);
+    e->height = b[8] | (b[9] << 8);
+    pos = 13 + ((b[10] & 0x80) ? 3 << ((b[10] & 7) + 1) : 0);
+    while (pos < length && f.seek(pos)) {
+        int type = f.read();
+        if (type == 0x21) {
+            int label = f.read();
+            pos += 2;
+            if (label == 0xF9 && f.read(b, 6) == 6)
+                delay = b[2] | (b[3] << 8);
+        } else if (type == 0x2C) {
+            if (f.read(b, 9) != 9)
+                break;
+            pos += 1 + 9 + ((b[8] & 0x80) ? 3 << ((b[8] & 7) + 1) : 0) + 1;  // descriptor, table, LZW code size
+            e->frameCount++;
+            e->loopTime += (delay < 2) ? 20 : delay * 10;
+        } else {
+            break;    // trailer or junk
+        }
+        // sub-blocks
+        int len;
+        while (pos < length && f.seek(pos) && (len = f.read()) > 0)
+            pos += 1 + len;
+        pos++;
+    }
+}
+
+// The record for name and size in the old catalog.  Looks at *cursor first
+bool findRecord(const char *name, uint32_t size, int *cursor, gif_catalog_entry *e) {
+    for (int i = 0; i < catalogCount; i++) {
+        int k = (*cursor + i) % catalogCount;
+        if (readCatalog(k, e) && e->size == size && strcmp(e->name, name) == 0) {
+            *cursor = k + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool copyFile(const char *from, const char *to) {
+    uint8_t buf[512];
+    File src = SD.open(from);
+    SD.remove(to);
+    File dst = SD.open(to, FILE_WRITE);
+    bool good = src && dst;
+    int n;
+    while (good && (n = src.read(buf, sizeof(buf))) > 0)
+        good = dst.write(buf, n) == (size_t)n;
+    if (src) src.close();
+    if (dst) dst.close();
+    if (!good) SD.remove(to);
+    return good;
+}
+
+// Files in the directory.  -1 = no catalog could be made
+int syncCatalog(const char *directoryName, bool displayFilenames) {
+    char path[GIF_PATH_MAX], newPath[GIF_PATH_MAX];
+    if (!joinPath(path, directoryName, CATALOG_FILE) || !joinPath(newPath, directoryName, "_catalog.new"))
+        return -1;
+    int oldCount = openCatalog(path);
+    File directory = SD.open(directoryName);
+    if (!directory)
+        return -1;
+
+    // pass 1: the same files in the same places?
+    File entry;
+    gif_catalog_entry e;
+    int count = 0;
+    uint32_t dirIndex = 0;
+    bool same = oldCount >= 0;
+    while (same && (entry = directory.openNextFile())) {
+        const char *name = baseName(entry.name());
+        if (!entry.isDirectory() && strlen(name) < CATALOG_NAME && isAnimationFile(name)) {
+            same = readCatalog(count++, &e) && e.dirIndex == dirIndex && e.size == entry.size() && strcmp(e.name, name) == 0;
+        }
+        entry.close();
+        dirIndex++;
+    }
+    directory.close();
+    if (same && count == oldCount) {
+        strcpy(catalogDirectory, directoryName);
+        if (displayFilenames) {
+            Serial.print("Catalog: ");
+            Serial.println(count);
+        }
+        return count;
+    }
+
+    // pass 2: write a new catalog.  Records of unchanged files are kept
+    directory = SD.open(directoryName);
+    SD.remove(newPath);
+    File out = SD.open(newPath, FILE_WRITE);
+    if (!directory || !out) {
+        if (directory) directory.close();
+        if (out) out.close();
+        return -1;
+    }
+    catalog_header head = { { 'G', 'C', 'T', '1' }, sizeof(gif_catalog_entry), 0 };
+    bool good = out.write((const uint8_t *)&head, sizeof(head)) == sizeof(head);
+    int cursor = 0, probed = 0;
+    count = 0;
+    dirIndex = 0;
+    while (good && (entry = directory.openNextFile())) {
+        const char *name = baseName(entry.name());
+        if (!entry.isDirectory() && strlen(name) < CATALOG_NAME && isAnimationFile(name)) {
+            uint32_t size = entry.size();
+            if (!findRecord(name, size, &cursor, &e)) {
+                memset(&e, 0, sizeof(e));
+                strcpy(e.name, name);
+                e.size = size;
+                probeFile(entry, &e);
+                probed++;
+                if (displayFilenames) {
+                    char buf[100];
+                    sprintf(buf, "%d:%s %dx%d %d frames %ldms size:%ld", count + 1, name,
+                            e.width, e.height, e.frameCount, (long)e.loopTime, (long)size);
+                    Serial.println(buf);
+                }
+            }
+            e.dirIndex = dirIndex;
+            good = out.write((const uint8_t *)&e, sizeof(e)) == sizeof(e);
+            count++;
+        }
+        entry.close();
+        dirIndex++;
+    }
+    directory.close();
+    catalog_trailer tail = { { 'G', 'C', 'T', '!' }, (uint32_t)count };
+    good = good && out.write((const uint8_t *)&tail, sizeof(tail)) == sizeof(tail);
+    out.close();
+    if (catalogFile)
+        catalogFile.close();
+    catalogCount = 0;
+    good = good && copyFile(newPath, path);
+    SD.remove(newPath);
+    if (!good || openCatalog(path) != count)
+        return -1;
+    strcpy(catalogDirectory, directoryName);
+    if (displayFilenames) {
+        Serial.print("Catalog: ");
+        Serial.print(count);
+        Serial.print(" probed: ");
+        Serial.println(probed);
+    }
+    return count;
+}
+
+bool getGIFInfo(int index, gif_catalog_entry *entry) {
+    return readCatalog(index, entry);
+}
+#else
+bool getGIFInfo(int index, gif_catalog_entry *entry) {
+    return false;
+}
+#endif
+
 // Enumerate and possibly display the animated GIF filenames in GIFS directory
 int enumerateGIFFiles(const char *directoryName, bool displayFilenames) {
 
     char *filename;
     numberOfFiles = 0;
+#if GIF_INDEX_POOL > 0
+    bool indexing = strlen(directoryName) < sizeof(indexDirectory);
+    indexUsed = indexCount = 0;
+    strcpy(indexDirectory, indexing ? directoryName : "");
+#endif
+#if defined(GIF_CATALOG) && !defined(USE_SPIFFS)
+    if (strlen(directoryName) < sizeof(catalogDirectory)) {
+        int count = syncCatalog(directoryName, displayFilenames);
+        if (count >= 0)
+            return numberOfFiles = count;
+    }
+#endif
 #ifdef USE_SPIFFS_DIR
     File file;
     Dir directory = SPIFFS.openDir(directoryName);
@@ -112,6 +408,14 @@ int enumerateGIFFiles(const char *directoryName, bool displayFilenames) {
 #endif
         filename = (char*)file.name();
         if (isAnimationFile(filename)) {
+#if GIF_INDEX_POOL > 0
+            int len = strlen(filename) + 1;
+            if (indexing && indexCount == numberOfFiles && indexCount < GIF_INDEX_FILES && indexUsed + len <= GIF_INDEX_POOL) {
+                indexOffset[indexCount++] = indexUsed;
+                memcpy(indexPool + indexUsed, filename, len);
+                indexUsed += len;
+            }
+#endif
             numberOfFiles++;
             if (displayFilenames) {
                 Serial.print(numberOfFiles);
@@ -130,6 +434,12 @@ int enumerateGIFFiles(const char *directoryName, bool displayFilenames) {
 #else
     directory.close();
 #endif
+#if GIF_INDEX_POOL > 0
+    if (displayFilenames && indexCount < numberOfFiles) {
+        Serial.print("Indexed: ");
+        Serial.println(indexCount);
+    }
+#endif
 
     return numberOfFiles;
 }
@@ -143,6 +453,20 @@ void getGIFFilenameByIndex(const char *directoryName, int index, char *pnBuffer)
     if ((index < 0) || (index >= numberOfFiles))
         return;
 
+#if defined(GIF_CATALOG) && !defined(USE_SPIFFS)
+    gif_catalog_entry e;
+    if (strcmp(directoryName, catalogDirectory) == 0 && readCatalog(index, &e)) {
+        joinPath(pnBuffer, directoryName, e.name);    //.kbv no directory walk
+        return;
+    }
+#endif
+#if GIF_INDEX_POOL > 0
+    if (index < indexCount && strcmp(directoryName, indexDirectory) == 0) {
+        joinPath(pnBuffer, directoryName, indexPool + indexOffset[index]);
+        return;
+    }
+#endif
+
 #ifdef USE_SPIFFS_DIR
     Dir directory = SPIFFS.openDir(directoryName);
     //    if (!directory) return;
@@ -164,17 +488,8 @@ void getGIFFilenameByIndex(const char *directoryName, int index, char *pnBuffer)
         filename = (char*)file.name();  //.kbv
         if (isAnimationFile(filename)) {
             index--;
-
-            // Copy the directory name into the pathname buffer
-            strcpy(pnBuffer, directoryName);
-#if defined(ESP32) || defined(USE_SPIFFS)
-            pnBuffer[0] = 0;
-#else
-            int len = strlen(pnBuffer);
-            if (len == 0 || pnBuffer[len - 1] != '/') strcat(pnBuffer, "/");
-#endif
-            // Append the filename to the pathname
-            strcat(pnBuffer, filename);
+            if (index < 0)
+                joinPath(pnBuffer, directoryName, filename);
         }
 
         file.close();
@@ -188,12 +503,17 @@ void getGIFFilenameByIndex(const char *directoryName, int index, char *pnBuffer)
 }
 
 int openGifFilenameByIndex(const char *directoryName, int index) {
-    char pathname[40];
+    char pathname[GIF_PATH_MAX];
 
+    pathname[0] = 0;
     getGIFFilenameByIndex(directoryName, index, pathname);
 
     Serial.print("Pathname: ");
     Serial.println(pathname);
+    if (pathname[0] == 0) {
+        Serial.println("No such file, or path longer than GIF_PATH_MAX");
+        return -1;
+    }
 
     if (file)
         file.close();
@@ -208,10 +528,22 @@ int openGifFilenameByIndex(const char *directoryName, int index) {
         Serial.println("Error opening GIF file");
         return -1;
     }
+    streamOpen = hasSuffix(pathname, ".GFS");
 
     return 0;
 }
 
+bool openPackFile(const char *pathname) {
+    if (file)
+        file.close();
+#ifdef USE_SPIFFS
+    file = SPIFFS.open(pathname, "r");
+#else
+    file = SD.open(pathname);
+#endif
+    streamOpen = false;
+    return file;
+}
 
 // Return a random animated gif path/filename from the specified directory
 void chooseRandomGIFFilename(const char *directoryName, char *pnBuffer) {
@@ -219,3 +551,180 @@ void chooseRandomGIFFilename(const char *directoryName, char *pnBuffer) {
     int index = random(numberOfFiles);
     getGIFFilenameByIndex(directoryName, index, pnBuffer);
 }
+
+// Replay cache files.  The decoder records a loop into one and replays it on later loops
+// and later visits with big sequential reads instead of LZW
+// .kbv the name comes from the GIF's size and a checksum of its first and last 4kB, so a
+//   GIF that is replaced gets a new file.  The header repeats them with the sketch's
+//   settings.  A recording is only trusted if it ends with the trailer, which is written
+//   when the decoder seeks back to the start to replay it
+#ifdef USE_SPIFFS
+int openCacheFile(unsigned long settings, long budget) {
+    return -1;   //.kbv flash is too small and wears out
+}
+
+void closeCacheFile(void) {
+}
+
+bool cacheSeekCallback(unsigned long position) {
+    return false;
+}
+
+int cacheReadCallback(void * buffer, int numberOfBytes) {
+    return -1;
+}
+
+int cacheWriteCallback(const void * buffer, int numberOfBytes) {
+    return -1;
+}
+#else
+typedef struct cache_header {
+    char magic[4];          // "GFC1"
+    uint32_t gifSize;
+    uint32_t gifChecksum;
+    uint32_t settings;
+} cache_header;
+
+typedef struct cache_trailer {
+    char magic[4];          // "GFC!"
+    uint32_t length;        // bytes between header and trailer
+} cache_trailer;
+
+File cacheFile;
+char cachePath[24];
+bool cacheWriting;          // recording.  no trailer yet
+long cacheWritten;
+long cacheAllowance;        // bytes this file may grow to
+
+uint32_t cacheChecksum(uint32_t h, unsigned long from, unsigned long to) {
+    uint8_t buf[64];
+    file.seek(from);
+    while (from < to) {
+        int n = (to - from < sizeof(buf)) ? to - from : sizeof(buf);
+        if (file.read(buf, n) != n)
+            break;
+        for (int i = 0; i < n; i++)
+            h = (h ^ buf[i]) * 16777619UL;    // FNV-1a
+        from += n;
+    }
+    return h;
+}
+
+// Bytes used by the other cache files.  evict: delete the first of them instead and return its size.  -1 = none
+long cacheDirectory(bool evict) {
+    long used = 0;
+    File directory = SD.open(CACHE_DIRECTORY);
+    if (!directory)
+        return evict ? -1 : 0;
+    File entry;
+    while (entry = directory.openNextFile()) {
+        char path[GIF_PATH_MAX];
+        bool named = joinPath(path, CACHE_DIRECTORY, baseName(entry.name()));
+        long size = entry.size();
+        bool skip = !named || entry.isDirectory() || strcmp(path, cachePath) == 0;
+        entry.close();
+        if (skip)
+            continue;
+        if (evict) {
+            directory.close();
+            SD.remove(path);
+            return size;
+        }
+        used += size;
+    }
+    directory.close();
+    return evict ? -1 : used;
+}
+
+int openCacheFile(unsigned long settings, long budget) {
+    closeCacheFile();
+    if (!file || budget <= 0)
+        return -1;
+    uint32_t size = file.size();
+    uint32_t sample = (size < 4096) ? size : 4096;
+    cache_header want = { { 'G', 'F', 'C', '1' }, size,
+                          cacheChecksum(cacheChecksum(2166136261UL, 0, sample), size - sample, size), (uint32_t)settings };
+    file.seek(0);
+    sprintf(cachePath, "%s/%08lX.GFC", CACHE_DIRECTORY, (unsigned long)(want.gifChecksum ^ size));
+
+    cacheFile = SD.open(cachePath);
+    if (cacheFile) {
+        cache_header head;
+        cache_trailer tail;
+        unsigned long length = cacheFile.size();
+        bool good = length >= sizeof(head) + sizeof(tail)
+                    && cacheFile.read((uint8_t *)&head, sizeof(head)) == sizeof(head)
+                    && memcmp(&head, &want, sizeof(head)) == 0
+                    && cacheFile.seek(length - sizeof(tail))
+                    && cacheFile.read((uint8_t *)&tail, sizeof(tail)) == sizeof(tail)
+                    && memcmp(tail.magic, "GFC!", 4) == 0
+                    && tail.length == length - sizeof(head) - sizeof(tail);
+        if (good)
+            return 1;
+        cacheFile.close();
+        SD.remove(cachePath);    // other settings, or never finished
+    }
+
+    // .kbv delete other GIFs' files until this one may have a quarter of the budget
+    if (!SD.exists(CACHE_DIRECTORY))
+        SD.mkdir(CACHE_DIRECTORY);
+    long used = cacheDirectory(false);
+    while (budget - used < budget / 4) {
+        long freed = cacheDirectory(true);
+        if (freed < 0)
+            break;
+        used -= freed;
+    }
+    cacheAllowance = budget - used;
+    if (cacheAllowance <= (long)(sizeof(cache_header) + sizeof(cache_trailer)))
+        return -1;
+    cacheFile = SD.open(cachePath, FILE_WRITE);
+    cacheWriting = true;
+    cacheWritten = 0;
+    if (!cacheFile || cacheFile.write((const uint8_t *)&want, sizeof(want)) != sizeof(want)) {
+        closeCacheFile();
+        return -1;
+    }
+    return 0;
+}
+
+void closeCacheFile(void) {
+    if (cacheFile)
+        cacheFile.close();
+    if (cacheWriting)
+        SD.remove(cachePath);
+    cacheWriting = false;
+}
+
+bool cacheSeekCallback(unsigned long position) {
+    if (cacheWriting) {
+        // the loop is recorded.  finish the file and read it from now on
+        cache_trailer tail = { { 'G', 'F', 'C', '!' }, (uint32_t)cacheWritten };
+        bool good = cacheFile.write((const uint8_t *)&tail, sizeof(tail)) == sizeof(tail);
+        cacheFile.close();
+        cacheWriting = false;
+        if (!good) {
+            SD.remove(cachePath);
+            return false;
+        }
+        cacheFile = SD.open(cachePath);
+        if (!cacheFile)
+            return false;
+    }
+    return cacheFile.seek(position);
+}
+
+int cacheReadCallback(void * buffer, int numberOfBytes) {
+    return cacheFile.read((uint8_t*)buffer, numberOfBytes);
+}
+
+int cacheWriteCallback(const void * buffer, int numberOfBytes) {
+    long room = cacheAllowance - sizeof(cache_header) - sizeof(cache_trailer) - cacheWritten;
+    if (!cacheWriting || numberOfBytes > room)
+        return 0;    //.kbv over budget.  The decoder gives up and closeCacheFile() deletes the file
+    int n = cacheFile.write((const uint8_t *)buffer, numberOfBytes);
+    if (n > 0)
+        cacheWritten += n;
+    return n;
+}
+#endif
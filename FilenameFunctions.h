@@ -2,15 +2,67 @@
 #define FILENAME_FUNCTIONS_H
 
 //#define USE_SPIFFS
+//#define GIF_STREAMS   //.GFS files made by tools/gif2stream are listed with the GIFs
+//#define GIF_CATALOG   //names and probe data kept in CATALOG_FILE in the GIF directory.  Opening file N is a direct open
+
+#include <stdint.h>
+
+// Names kept by enumerateGIFFiles() so that opening file N is not a directory walk.
+// Files past GIF_INDEX_FILES, or past GIF_INDEX_POOL bytes of names, are still found by
+// walking the directory.  GIF_CATALOG opens file N from its record, so there is no index
+#if !defined(GIF_INDEX_POOL)
+#if defined(__AVR__)
+#define GIF_INDEX_POOL   0    //.kbv no RAM to spare
+#define GIF_INDEX_FILES  0
+#define GIF_PATH_MAX     64
+#elif defined(GIF_CATALOG) && !defined(USE_SPIFFS)
+#define GIF_INDEX_POOL   0    //.kbv a catalog that can't be written falls back to walking
+#define GIF_INDEX_FILES  0
+#define GIF_PATH_MAX     256
+#else
+#define GIF_INDEX_POOL   2048
+#define GIF_INDEX_FILES  256
+#define GIF_PATH_MAX     256  //.kbv a long FAT name and its directory
+#endif
+#endif
 
 int enumerateGIFFiles(const char *directoryName, bool displayFilenames);
-void getGIFFilenameByIndex(const char *directoryName, int index, char *pnBuffer);
+void getGIFFilenameByIndex(const char *directoryName, int index, char *pnBuffer);  //.kbv pnBuffer holds GIF_PATH_MAX.  "" = too long
 int openGifFilenameByIndex(const char *directoryName, int index);
 int initSdCard(int chipSelectPin);
+bool isStreamOpen(void);  //.kbv the open file is a .GFS stream
+bool openPackFile(const char *pathname);  //.kbv a pack from tools/gifpack.  The file callbacks read it until the next open
 
 bool fileSeekCallback(unsigned long position);
 unsigned long filePositionCallback(void);
 int fileReadCallback(void);
 int fileReadBlockCallback(void * buffer, int numberOfBytes);
 
+// Directory catalog.  Records in directory order, then a trailer.  Names starting with '_' are not GIFs
+#define CATALOG_FILE     "_catalog.gct"
+#define CATALOG_NAME     44   //.kbv longer names are left out
+#define CATALOG_STREAM   0x0001
+
+typedef struct gif_catalog_entry {
+    char name[CATALOG_NAME];    // NUL terminated.  no directory
+    uint32_t size;
+    int16_t width, height;      // logical screen
+    uint16_t frameCount;
+    uint16_t flags;             // CATALOG_xxx
+    uint32_t loopTime;          // ms
+    uint32_t dirIndex;          // position in the directory, counting every entry
+} gif_catalog_entry;
+
+bool getGIFInfo(int index, gif_catalog_entry *entry);  //.kbv false = no catalog
+
+// Replay cache files for GifDecoder::setCacheFile().  One per GIF in CACHE_DIRECTORY
+#define CACHE_DIRECTORY  "/gifcache"
+#define CACHE_FILE_START 16   //.kbv header: "GFC1", GIF size, GIF checksum, settings
+
+int openCacheFile(unsigned long settings, long budget);  //.kbv for the open GIF.  1 = holds a loop, 0 = empty, -1 = no cache
+void closeCacheFile(void);  //.kbv a recording that didn't finish is deleted
+bool cacheSeekCallback(unsigned long position);
+int cacheReadCallback(void * buffer, int numberOfBytes);
+int cacheWriteCallback(const void * buffer, int numberOfBytes);
+
 #endif
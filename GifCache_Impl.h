@@ -0,0 +1,497 @@
+/*
+    Animated GIFs Display Code for SmartMatrix and 32x32 RGB LED Panels
+
+    This file contains the frame cache.  While a loop of the animation plays it is recorded
+    in the caller's buffer.  If the whole loop fits, the following loops are replayed from
+    the buffer with no file reads or LZW.  A loop that doesn't fit is abandoned and the GIF
+    is decoded as usual
+
+    Two kinds of recording:
+    sinks: every call to the display callbacks.  Replay is the same calls with the same
+      display pixels.  Record layout: a gif_cache_op followed by its data, padded to 4 bytes
+      .kbv the buffer should be 4-byte aligned (malloc is) so replayed pixels are aligned
+    display list: windows, fills and rows of palette indices as they reach the output stage,
+      with each colour table stored once.  Replay goes through the output stage again, so it
+      works with whichever callbacks are set and with the current colour settings.
+      About half the size of the sink recording for 16-bit pixels
+
+    A cache file (setCacheFile()) takes recordings that don't fit in RAM, and keeps them
+    for the next time the GIF is played.  The buffer then holds one chunk of the file.
+    Each chunk is its length followed by whole records, written when the buffer fills
+    and read back in one piece
+*/
+
+#if defined (ARDUINO)
+#include <Arduino.h>
+#elif defined (SPARK)
+#include "application.h"
+#endif
+
+#include "GifDecoder.h"
+
+typedef struct gif_cache_op {
+    uint8_t op;
+    uint8_t pad;
+    int16_t arg;
+    int16_t x, y, w, h;
+} gif_cache_op;
+
+static inline void listPut16(uint8_t *p, int v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static inline int16_t listGet16(const uint8_t *p) {
+    return (int16_t)(p[0] | (p[1] << 8));
+}
+
+// Takes effect at the next startDecoding()
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setFrameCache(uint8_t *buf, long size, bool displayList) {
+#if NO_IMAGEDATA < 2
+    buf = 0;    // .kbv only the line decoder's output is recorded
+#endif
+    cacheBuf = buf;
+    cacheSize = buf ? size : 0;
+    cacheList = displayList;
+    cacheState = GIF_CACHE_OFF;
+    cacheUsed = cachePos = 0;
+}
+
+// Recordings go to the file from start on.  recorded: it already holds a loop made with
+// the same output settings.  Takes effect at the next startDecoding()
+// .kbv the decoder seeks to start when a recording is complete and when each replay begins
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setCacheFile(cache_seek_callback seek, cache_read_callback read, cache_write_callback write, unsigned long start, bool recorded) {
+    cacheSeek = seek;
+    cacheRead = read;
+    cacheWrite = write;
+    cacheStart = start;
+    cacheRecorded = recorded && seek && read;
+}
+
+// New GIF.  Loop 1 is recorded, or replayed from a cache file
+// .kbv with a composite, loop 1 is compared with a blank screen.  Loop 2 on are compared
+//   with the end of the previous loop and send the same pixels, so loop 2 is recorded
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::resetCache(void) {
+    cachePos = 0;
+    cacheStale = false;
+    startRecording();
+    if (cacheBuf == 0)
+        cacheState = GIF_CACHE_OFF;
+    else if (cacheRecorded && compositeBuffer)
+        cacheState = GIF_CACHE_READY;
+    else if (cacheRecorded) {
+        startReplay();
+        if (cacheState == GIF_CACHE_REPLAY && !nextChunk())
+            cacheState = GIF_CACHE_FULL;  // .kbv unreadable file.  Decode the GIF instead
+    } else
+        cacheState = compositeBuffer ? GIF_CACHE_WAIT : GIF_CACHE_RECORD;
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::startRecording(void) {
+    cacheUsed = 0;
+    cachePalette = false;
+    cachePaletteCount = 0;
+    cacheCurPalette = -1;
+    cacheWinPos = -1;
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::startReplay(void) {
+    cacheState = GIF_CACHE_REPLAY;
+    cacheNewLoop = true;
+    cachePos = 0;
+    if (cacheSeek) {
+        cacheUsed = 0;
+        if (!(*cacheSeek)(cacheStart))
+            cacheState = GIF_CACHE_FULL;
+    }
+}
+
+// Output settings changed.  What is recorded no longer matches
+// .kbv replay can't stop in the middle of a loop because the file is at frame 1.
+//   It finishes the loop with the old settings and the next loop is recorded again.
+//   The display list converts colours as it replays, unless its spans were diffed with the composite.
+//   A cache file is only written once.  Settings made before the first frame of loop 1
+//   are taken to match the file.  Nothing but colour tables is recorded by then
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::dropCache(bool colours) {
+    dropKeyframes();    // .kbv snapshots are display pixels too
+    if (colours && cacheList && compositeBuffer == 0)
+        return;
+    if (cacheState == GIF_CACHE_RECORD && cacheUsed && !(keyFrame && cycleNo == 1))
+        cacheState = cacheWrite ? GIF_CACHE_FULL : GIF_CACHE_WAIT;
+    else if (cacheState == GIF_CACHE_REPLAY && !(cacheNewLoop && cycleNo == 1))
+        cacheStale = true;
+    else if (cacheState == GIF_CACHE_READY)
+        cacheState = GIF_CACHE_FULL;
+}
+
+// Make room for bytes of records.  A full buffer goes to the cache file if there is one.
+// false if there is no room, and the cache is abandoned for this GIF
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+bool GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::cacheRoom(long bytes) {
+    if (cacheUsed + bytes <= cacheSize)
+        return true;
+    if (cacheWrite && bytes <= cacheSize && flushChunk())
+        return true;
+    cacheState = GIF_CACHE_FULL;
+    return false;
+}
+
+// .kbv records never span chunks.  Palettes and windows are not carried over, so each
+//   chunk can be replayed from RAM on its own
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+bool GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::flushChunk(void) {
+    uint32_t len = cacheUsed;
+    if ((*cacheWrite)(&len, sizeof(len)) != sizeof(len) || (*cacheWrite)(cacheBuf, len) != (int)len)
+        return false;
+    cacheUsed = 0;
+    cachePalette = false;
+    cachePaletteCount = 0;
+    cacheCurPalette = -1;
+    cacheWinPos = -1;
+    return true;
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+bool GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::nextChunk(void) {
+    uint32_t len;
+    if (cacheRead == 0 || (*cacheRead)(&len, sizeof(len)) != sizeof(len) || len > (uint32_t)cacheSize)
+        return false;
+    if ((*cacheRead)(cacheBuf, len) != (int)len)
+        return false;
+    cacheUsed = len;
+    cachePos = 0;
+    return true;
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+long GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::cachePayload(uint8_t op, int w, int h) {
+    switch (op) {
+        case CACHE_OP_FILL:     return sizeof(gif_pixel_t);
+        case CACHE_OP_ROW:      return (long)w * sizeof(gif_pixel_t);
+        case CACHE_OP_BLOCK:    return (long)w * h * sizeof(gif_pixel_t);
+        case CACHE_OP_PALETTE:  return 256 * sizeof(gif_pixel_t);
+        case CACHE_OP_LINE:     return w;
+        case CACHE_OP_PIXEL:    return 3;
+    }
+    return 0;
+}
+
+// Append an op.  false if the buffer is full, and the cache is abandoned for this GIF
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+bool GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::cacheOp(uint8_t op, int x, int y, int w, int h, const void *data, int arg) {
+    long bytes = cachePayload(op, w, h);
+    long need = sizeof(gif_cache_op) + ((bytes + 3) & ~3L);
+    if (!cacheRoom(need))
+        return false;
+    gif_cache_op *p = (gif_cache_op *)(cacheBuf + cacheUsed);
+    p->op = op;
+    p->pad = 0;
+    p->arg = arg;
+    p->x = x;
+    p->y = y;
+    p->w = w;
+    p->h = h;
+    if (bytes)
+        memcpy(p + 1, data, bytes);
+    cacheUsed += need;
+    return true;
+}
+
+// A line callback.  The palette goes in once per colour table
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::cacheLine(int x, int y, uint8_t *buf, int wid, int skip) {
+    if (!cacheRoom(2 * sizeof(gif_cache_op) + 256 * sizeof(gif_pixel_t) + ((wid + 3) & ~3)))
+        return;
+    if (!cachePalette) {
+        if (!cacheOp(CACHE_OP_PALETTE, 0, 0, 0, 0, displayPalette))
+            return;
+        cachePalette = true;
+    }
+    cacheOp(CACHE_OP_LINE, x, y, wid, 1, buf, skip);
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::cacheClear(void) {
+    if (cacheList) {
+        uint8_t op = LIST_OP_CLEAR;
+        listBytes(&op, 1);
+    } else {
+        cacheOp(CACHE_OP_CLEAR, 0, 0, 0, 0, 0);
+    }
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::cacheFrameEnd(void) {
+    if (cacheList) {
+        uint8_t rec[3] = { LIST_OP_FRAME };
+        listPut16(rec + 1, frameDelay);
+        listBytes(rec, sizeof(rec));
+        cacheWinPos = -1;
+    } else {
+        cacheOp(CACHE_OP_FRAME, dirtyRect.x, dirtyRect.y, dirtyRect.w, dirtyRect.h, 0, frameDelay);
+    }
+}
+
+// The file has been read to the trailer
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::cacheLoopEnd(void) {
+    if (cacheState == GIF_CACHE_RECORD) {
+        uint8_t op = LIST_OP_LOOP;
+        if (cacheList ? listBytes(&op, 1) : cacheOp(CACHE_OP_LOOP, 0, 0, 0, 0, 0)) {
+            if (cacheWrite && !flushChunk())
+                cacheState = GIF_CACHE_FULL;
+            else
+                startReplay();
+        }
+    } else if (cacheState == GIF_CACHE_READY) {
+        startReplay();
+    } else if (cacheState == GIF_CACHE_WAIT) {
+        cacheState = GIF_CACHE_RECORD;
+        startRecording();
+    }
+}
+
+// Send one recorded frame.  Returns what decodeFrame() would have
+// .kbv frame numbers, delays, cycle counts and dirty rectangles follow the decoder's
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::replayFrame(void) {
+    if (cacheNewLoop) {
+        frameNo = 0;
+        cacheNewLoop = false;
+    }
+    int result = cacheList ? replayList() : replaySinks();
+    if (result == ERROR_NONE) {
+        frameNo++;
+        cycleTime += (frameDelay < 2) ? 20 : frameDelay * 10;
+        return result;
+    }
+    if (cacheState == GIF_CACHE_FULL) {
+        // .kbv the cache file couldn't be read.  The GIF is still at frame 1, so decode it
+        frameCount = frameNo;
+        cycleNo++;
+    } else if (cacheStale) {
+        // .kbv decode and record from the top of the file.  The header counts the cycle
+        cacheStale = false;
+        cacheState = cacheWrite ? GIF_CACHE_FULL : GIF_CACHE_RECORD;
+        startRecording();
+        fileSeekCallback(0);
+        parseGifHeader();
+        parseLogicalScreenDescriptor();
+        parseGlobalColorTable();
+    } else {
+        frameCount = frameNo;
+        cycleNo++;
+        startReplay();
+    }
+    return ERROR_DONE_PARSING;
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::replaySinks(void) {
+    for (;;) {
+        if (cachePos >= cacheUsed && !nextChunk()) {
+            cacheState = GIF_CACHE_FULL;
+            return ERROR_DONE_PARSING;
+        }
+        gif_cache_op *p = (gif_cache_op *)(cacheBuf + cachePos);
+        uint8_t *data = (uint8_t *)(p + 1);
+        gif_pixel_t *pixels = (gif_pixel_t *)data;
+        cachePos += sizeof(gif_cache_op) + ((cachePayload(p->op, p->w, p->h) + 3) & ~3L);
+        switch (p->op) {
+            case CACHE_OP_FILL:
+                (*fillRectCallback)(p->x, p->y, p->w, p->h, *pixels);
+                break;
+            case CACHE_OP_ROW:
+                (*drawRowCallback)(p->x, p->y, pixels, p->w);
+                break;
+            case CACHE_OP_BLOCK:
+                (*drawBlockCallback)(p->x, p->y, p->w, p->h, pixels);
+                break;
+            case CACHE_OP_PALETTE:
+                cacheLinePalette = pixels;
+                break;
+            case CACHE_OP_LINE:
+                (*drawLineCallback)(p->x, p->y, data, p->w, cacheLinePalette, p->arg);
+                break;
+            case CACHE_OP_PIXEL:
+                (*drawPixelCallback)(p->x, p->y, data[0], data[1], data[2]);
+                break;
+            case CACHE_OP_CLEAR:
+                (*screenClearCallback)();
+                break;
+            case CACHE_OP_FRAME:
+                dirtyRect.x = p->x;
+                dirtyRect.y = p->y;
+                dirtyRect.w = p->w;
+                dirtyRect.h = p->h;
+                frameDelay = p->arg;
+                return ERROR_NONE;
+            case CACHE_OP_LOOP:
+                return ERROR_DONE_PARSING;
+        }
+    }
+}
+
+// Append to the display list.  false if the buffer is full, and the cache is abandoned for this GIF
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+bool GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::listBytes(const void *data, long bytes) {
+    if (!cacheRoom(bytes))
+        return false;
+    memcpy(cacheBuf + cacheUsed, data, bytes);
+    cacheUsed += bytes;
+    return true;
+}
+
+// A span of palette indices in output coordinates
+// .kbv a row that continues the open window costs one byte.  The second row of a window
+//   sets its step, so interlaced passes and scaled frames are windows too
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::listSpan(int x, int y, uint8_t *buf, int wid, int skip) {
+    if (!cacheRoom(10 + 1 + wid))
+        return;
+    bool more = false;
+    if (cacheWinPos >= 0 && x == cacheWinX && wid == cacheWinW && skip == cacheWinSkip) {
+        int step = y - cacheWinY;
+        if (cacheWinRows == 1 && step > 0 && step < 256) {
+            cacheWinStep = step;
+            cacheBuf[cacheWinPos + 7] = step;
+            more = true;
+        } else {
+            more = (y == cacheWinY + cacheWinRows * cacheWinStep);
+        }
+    }
+    if (!more) {
+        uint8_t rec[10] = { LIST_OP_WINDOW };
+        listPut16(rec + 1, x);
+        listPut16(rec + 3, y);
+        listPut16(rec + 5, wid);
+        rec[7] = 1;
+        listPut16(rec + 8, skip);
+        cacheWinPos = cacheUsed;
+        if (!listBytes(rec, sizeof(rec)))
+            return;
+        cacheWinX = x;
+        cacheWinY = y;
+        cacheWinW = wid;
+        cacheWinSkip = skip;
+        cacheWinStep = 1;
+        cacheWinRows = 0;
+    }
+    uint8_t op = LIST_OP_ROW;
+    if (listBytes(&op, 1) && listBytes(buf, wid))
+        cacheWinRows++;
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::listFill(uint8_t colorIndex, int x, int y, int width, int height) {
+    uint8_t rec[10] = { LIST_OP_FILL, colorIndex };
+    listPut16(rec + 2, x);
+    listPut16(rec + 4, y);
+    listPut16(rec + 6, width);
+    listPut16(rec + 8, height);
+    listBytes(rec, sizeof(rec));
+}
+
+// A colour table has been read.  Tables already in the list are referred to
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::listPalette(void) {
+    long bytes = colorCount * 3L;
+    if (!cacheRoom(3 + bytes))
+        return;
+    for (int i = 0; i < cachePaletteCount; i++) {
+        long at = cachePalettes[i];
+        const uint8_t *p = cacheBuf + at;
+        if (listGet16(p + 1) == colorCount && memcmp(p + 3, palette, bytes) == 0) {
+            if (at != cacheCurPalette) {
+                uint8_t rec[5] = { LIST_OP_PALREF };
+                listPut16(rec + 1, at);
+                listPut16(rec + 3, at >> 16);
+                if (!listBytes(rec, sizeof(rec)))
+                    return;
+                cacheCurPalette = at;
+            }
+            return;
+        }
+    }
+    uint8_t rec[3] = { LIST_OP_PALETTE };
+    listPut16(rec + 1, colorCount);
+    long at = cacheUsed;
+    if (!listBytes(rec, sizeof(rec)) || !listBytes(palette, bytes))
+        return;
+    cacheCurPalette = at;
+    if (cachePaletteCount < CACHE_LIST_PALETTES)
+        cachePalettes[cachePaletteCount++] = at;
+}
+
+// A recorded span goes through the output stage.  The composite is brought up to date
+// first, as the diff would have done, so blocks padded from it are right
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::replaySpan(int x, int y, uint8_t *buf, int wid, int skip) {
+    if (compositeBuffer && y < compositeHeight && x + wid <= compositeWidth) {
+        gif_pixel_t *prev = compositeBuffer + y * compositeWidth + x;
+        expandRow(prev, buf, wid, skip, prev);
+    }
+    outputSpan(x, y, buf, wid, skip);
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::replayList(void) {
+    int wx = 0, wy = 0, wid = 0, step = 1, skip = -1, row = 0;
+    beginOutput();
+    for (;;) {
+        if (cachePos >= cacheUsed && !nextChunk()) {
+            cacheState = GIF_CACHE_FULL;
+            return ERROR_DONE_PARSING;
+        }
+        uint8_t *p = cacheBuf + cachePos;
+        switch (p[0]) {
+            case LIST_OP_WINDOW:
+                wx = listGet16(p + 1);
+                wy = listGet16(p + 3);
+                wid = listGet16(p + 5);
+                step = p[7];
+                skip = listGet16(p + 8);
+                row = 0;
+                cachePos += 10;
+                break;
+            case LIST_OP_ROW:
+                replaySpan(wx, wy + row * step, p + 1, wid, skip);
+                row++;
+                cachePos += 1 + wid;
+                break;
+            case LIST_OP_FILL:
+                fillDisplayRect(p[1], listGet16(p + 2), listGet16(p + 4), listGet16(p + 6), listGet16(p + 8));
+                cachePos += 10;
+                break;
+            case LIST_OP_PALETTE:
+            case LIST_OP_PALREF: {
+                const uint8_t *t = p;
+                if (p[0] == LIST_OP_PALREF)
+                    t = cacheBuf + ((uint16_t)listGet16(p + 1) | ((long)listGet16(p + 3) << 16));
+                colorCount = listGet16(t + 1);
+                memcpy(palette, t + 3, colorCount * 3L);
+                convertPalette();
+                cachePos += (p[0] == LIST_OP_PALREF) ? 5 : 3 + colorCount * 3L;
+                break;
+            }
+            case LIST_OP_CLEAR:
+                if (screenClearCallback)
+                    (*screenClearCallback)();
+                cachePos++;
+                break;
+            case LIST_OP_FRAME:
+                flushOutput();
+                frameDelay = listGet16(p + 1);
+                cachePos += 3;
+                return ERROR_NONE;
+            default:
+                return ERROR_DONE_PARSING;
+        }
+    }
+}
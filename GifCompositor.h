@@ -0,0 +1,84 @@
+#ifndef _GIFCOMPOSITOR_H_
+#define _GIFCOMPOSITOR_H_
+
+// Several GIFs playing at once on one canvas, e.g. icons and badges on a dashboard
+//
+// Each layer is a GIF in memory (PROGMEM or RAM) drawn at x, y.  Higher z is in front.
+// A layer decodes into an image the caller gives it, width * height of its GIF's
+// logical screen, capped at maxLayerWidth x maxLayerHeight.  A smaller image and the
+// layer is not added.  Layers take turns to decode and share one LZW dictionary.
+// update() decodes the layers whose frames are due and then sends the changed
+// rectangles of the canvas, with every layer painted in z order, to the row callback.
+// Overlapping rectangles are merged, so no pixel is sent twice.
+//
+// Layers are opaque rectangles.  setKeyColor() lets the layers behind show through
+// the pixels of one colour, e.g. the GIF's transparent areas before they are drawn
+
+#include "GifDecoder.h"
+
+#define COMPOSITOR_MAX_RECTS   8    //.kbv changed rectangles kept apart.  More are merged
+#define COMPOSITOR_ROW_PIXELS  160  //.kbv longest row sent in one callback
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+class GifCompositor {
+public:
+    int addLayer(const uint8_t *gif, unsigned long size, gif_pixel_t *image, long pixels, int16_t x, int16_t y, int8_t z = 0);  //.kbv layer number.  -1 = no room, image too small or not a GIF
+    void removeLayer(int layer);
+    void moveLayer(int layer, int16_t x, int16_t y, int8_t z);
+    void setKeyColor(int layer, bool on, gif_pixel_t color = gif_pixel_t());  //.kbv layer pixels of this colour are see-through
+    void setCanvas(int16_t width, int16_t height, gif_pixel_t background);  //.kbv panel size and colour behind every layer
+    void setWireOrder(bool bigEndian);  //.kbv as GifDecoder::setWireOrder()
+    void setDrawRowCallback(row_callback f);
+    void setStartDrawingCallback(callback f);  //.kbv before the first row of an update
+    void redraw(void);  //.kbv send the whole canvas on the next update()
+    long update(void);  //.kbv decode what is due and draw it.  ms until the next frame is due.  -1 = no layers
+    gif_rect getDirtyRect(void) { return dirtyBounds; }  //.kbv everything the last update() sent. w == 0 if none
+
+private:
+    typedef GifDecoder<maxLayerWidth, maxLayerHeight, 0> layer_decoder;
+
+    typedef struct layer_t {
+        const uint8_t *data;
+        unsigned long size;
+        unsigned long seek;
+        gif_pixel_t *image; //.kbv the layer's current frame, rows width apart
+        long pixels;
+        int16_t x, y, width, height;
+        int8_t z;
+        bool used;
+        bool keyed;
+        gif_pixel_t key;
+        unsigned long due;  //.kbv millis() of the next frame
+    } layer_t;
+
+    bool startLayer(int i);
+    bool decodeLayer(int i);
+    void markDirty(int x, int y, int width, int height);
+    void markLayer(int i);
+    void sortLayers(void);
+    void drawRect(const gif_rect &r);
+    gif_pixel_t wirePixel(gif_pixel_t color) { return wireOrder ? gif_format::swapped(color) : color; }
+
+    // file callbacks for whichever layer is decoding
+    static layer_t *source;
+    static bool fileSeekCallback(unsigned long position);
+    static unsigned long filePositionCallback(void);
+    static int fileReadCallback(void);
+    static int fileReadBlockCallback(void *buffer, int numberOfBytes);
+
+    int16_t canvasWidth, canvasHeight;
+    gif_pixel_t background;
+    bool wireOrder;
+    row_callback drawRowCallback;
+    callback startDrawingCallback;
+    int8_t order[maxLayers]; //.kbv layer numbers, back to front
+    int orderCount;
+    gif_rect dirty[COMPOSITOR_MAX_RECTS];
+    int dirtyCount;
+    gif_rect dirtyBounds;
+    gif_lzw_arena lzwArena; //.kbv one dictionary for every layer
+    layer_t layers[maxLayers];
+    layer_decoder decoders[maxLayers];
+};
+
+#endif
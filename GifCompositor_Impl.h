@@ -0,0 +1,351 @@
+/*
+    GIF layers on a shared canvas.  See GifCompositor.h
+
+    .kbv include after GifDecoder_Impl.h, LzwDecoder_Impl.h and GifOutput_Impl.h
+*/
+
+#if defined (ARDUINO)
+#include <Arduino.h>
+#elif defined (SPARK)
+#include "application.h"
+#endif
+
+#include "GifCompositor.h"
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+typename GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::layer_t *GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::source;
+
+static bool gifRectsTouch(const gif_rect &a, const gif_rect &b) {
+    return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+}
+
+static gif_rect gifRectBounds(const gif_rect &a, const gif_rect &b) {
+    gif_rect r;
+    r.x = min(a.x, b.x);
+    r.y = min(a.y, b.y);
+    r.w = max(a.x + a.w, b.x + b.w) - r.x;
+    r.h = max(a.y + a.h, b.y + b.h) - r.y;
+    return r;
+}
+
+// File callbacks.  Only one layer decodes at a time, so source says which
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+bool GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::fileSeekCallback(unsigned long position) {
+    source->seek = position;
+    return position <= source->size;
+}
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+unsigned long GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::filePositionCallback(void) {
+    return source->seek;
+}
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+int GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::fileReadCallback(void) {
+    if (source->seek >= source->size)
+        return -1;
+    return pgm_read_byte(source->data + source->seek++);
+}
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+int GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::fileReadBlockCallback(void *buffer, int numberOfBytes) {
+    if (source->seek >= source->size)
+        return -1;
+    if (numberOfBytes > (long)(source->size - source->seek))
+        numberOfBytes = source->size - source->seek;
+    memcpy_P(buffer, source->data + source->seek, numberOfBytes);
+    source->seek += numberOfBytes;
+    return numberOfBytes;
+}
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+int GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::addLayer(const uint8_t *gif, unsigned long size, gif_pixel_t *image, long pixels, int16_t x, int16_t y, int8_t z) {
+    int i;
+    for (i = 0; i < maxLayers && layers[i].used; i++)
+        ;
+    if (i == maxLayers)
+        return -1;
+    layer_t &layer = layers[i];
+    layer.data = gif;
+    layer.size = size;
+    layer.image = image;
+    layer.pixels = image ? pixels : 0;
+    layer.x = x;
+    layer.y = y;
+    layer.z = z;
+    layer.keyed = false;
+    layer_decoder &decoder = decoders[i];
+    decoder.setLzwArena(&lzwArena);
+    decoder.setFileSeekCallback(fileSeekCallback);
+    decoder.setFilePositionCallback(filePositionCallback);
+    decoder.setFileReadCallback(fileReadCallback);
+    decoder.setFileReadBlockCallback(fileReadBlockCallback);
+    if (!startLayer(i))
+        return -1;
+    layer.used = true;
+    sortLayers();
+    markLayer(i);
+    return i;
+}
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+void GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::removeLayer(int layer) {
+    if (layer < 0 || layer >= maxLayers || !layers[layer].used)
+        return;
+    markLayer(layer);
+    layers[layer].used = false;
+    sortLayers();
+}
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+void GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::moveLayer(int layer, int16_t x, int16_t y, int8_t z) {
+    if (layer < 0 || layer >= maxLayers || !layers[layer].used)
+        return;
+    markLayer(layer);
+    layers[layer].x = x;
+    layers[layer].y = y;
+    layers[layer].z = z;
+    sortLayers();
+    markLayer(layer);
+}
+
+// .kbv the layer's image starts out as the key colour, so the layer restarts
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+void GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::setKeyColor(int layer, bool on, gif_pixel_t color) {
+    if (layer < 0 || layer >= maxLayers || !layers[layer].used)
+        return;
+    layers[layer].keyed = on;
+    layers[layer].key = color;
+    if (!startLayer(layer))
+        removeLayer(layer);
+    else
+        markLayer(layer);
+}
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+void GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::setCanvas(int16_t width, int16_t height, gif_pixel_t color) {
+    canvasWidth = width;
+    canvasHeight = height;
+    background = color;
+    redraw();
+}
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+void GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::setWireOrder(bool bigEndian) {
+    wireOrder = bigEndian;
+    for (int i = 0; i < maxLayers; i++) {
+        if (layers[i].used && !startLayer(i))
+            removeLayer(i);
+    }
+    redraw();
+}
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+void GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::setDrawRowCallback(row_callback f) {
+    drawRowCallback = f;
+}
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+void GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::setStartDrawingCallback(callback f) {
+    startDrawingCallback = f;
+}
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+void GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::redraw(void) {
+    if (canvasWidth > 0) {
+        markDirty(0, 0, canvasWidth, canvasHeight);
+        return;
+    }
+    for (int i = 0; i < maxLayers; i++) {
+        if (layers[i].used)
+            markLayer(i);
+    }
+}
+
+// (Re)start a layer's GIF from the first frame.  The image is cleared to the key or background colour
+// .kbv the size comes from the screen descriptor, so the header is read once without the image
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+bool GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::startLayer(int i) {
+    layer_t &layer = layers[i];
+    layer_decoder &decoder = decoders[i];
+    source = &layer;
+    decoder.setWireOrder(wireOrder);
+    decoder.setCompositeBuffer(0);
+    if (decoder.startDecoding() < 0)
+        return false;
+    layer.width = min(decoder.getLogicalWidth(), maxLayerWidth);
+    layer.height = min(decoder.getLogicalHeight(), maxLayerHeight);
+    if ((long)layer.width * layer.height > layer.pixels)
+        return false;
+    decoder.setCompositeBuffer(layer.image, layer.keyed ? layer.key : background, layer.width, layer.height);
+    if (decoder.startDecoding() < 0)
+        return false;
+    layer.due = millis();
+    return true;
+}
+
+// One frame of one layer into its image
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+bool GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::decodeLayer(int i) {
+    layer_t &layer = layers[i];
+    layer_decoder &decoder = decoders[i];
+    source = &layer;
+    int result = decoder.decodeFrame();
+    if (result == ERROR_DONE_PARSING)
+        result = decoder.decodeFrame();    // looped back to the first frame
+    if (result != ERROR_NONE)
+        return false;
+    gif_rect r = decoder.getDirtyRect();
+    if (r.w > 0)
+        markDirty(layer.x + r.x, layer.y + r.y, r.w, r.h);
+    return true;
+}
+
+// .kbv earliest deadline first.  Each layer decodes at most one frame per update().
+//   A layer that is more than a frame behind starts again from now instead of catching up
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+long GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::update(void) {
+    unsigned long now = millis();
+    for (;;) {
+        int next = -1;
+        for (int i = 0; i < maxLayers; i++) {
+            if (!layers[i].used || (long)(now - layers[i].due) < 0)
+                continue;
+            if (next < 0 || (long)(layers[i].due - layers[next].due) < 0)
+                next = i;
+        }
+        if (next < 0)
+            break;
+        layer_t &layer = layers[next];
+        if (!decodeLayer(next)) {
+            removeLayer(next);
+            continue;
+        }
+        long delay = decoders[next].getFrameDelay_ms();
+        layer.due += delay;
+        if ((long)(now - layer.due) >= 0)
+            layer.due = now + delay;
+    }
+
+    dirtyBounds.w = dirtyBounds.h = 0;
+    if (dirtyCount > 0 && startDrawingCallback)
+        (*startDrawingCallback)();
+    for (int i = 0; i < dirtyCount; i++) {
+        drawRect(dirty[i]);
+        dirtyBounds = dirtyBounds.w ? gifRectBounds(dirtyBounds, dirty[i]) : dirty[i];
+    }
+    dirtyCount = 0;
+
+    long wait = -1;
+    now = millis();
+    for (int i = 0; i < maxLayers; i++) {
+        if (!layers[i].used)
+            continue;
+        long t = (long)(layers[i].due - now);
+        if (t < 0) t = 0;
+        if (wait < 0 || t < wait) wait = t;
+    }
+    return wait;
+}
+
+// Add a changed rectangle of the canvas.  Rectangles that touch are merged
+// .kbv when the list is full the new one is merged with whichever grows least
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+void GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::markDirty(int x, int y, int width, int height) {
+    if (canvasWidth > 0) {
+        if (x < 0) {
+            width += x;
+            x = 0;
+        }
+        if (y < 0) {
+            height += y;
+            y = 0;
+        }
+        if (x + width > canvasWidth) width = canvasWidth - x;
+        if (y + height > canvasHeight) height = canvasHeight - y;
+    }
+    if (width <= 0 || height <= 0)
+        return;
+    gif_rect r = { (int16_t)x, (int16_t)y, (int16_t)width, (int16_t)height };
+    for (;;) {
+        int merge = -1;
+        for (int i = 0; i < dirtyCount && merge < 0; i++) {
+            if (gifRectsTouch(dirty[i], r))
+                merge = i;
+        }
+        if (merge < 0 && dirtyCount == COMPOSITOR_MAX_RECTS) {
+            long least = 0;
+            for (int i = 0; i < dirtyCount; i++) {
+                gif_rect b = gifRectBounds(dirty[i], r);
+                long growth = (long)b.w * b.h - (long)dirty[i].w * dirty[i].h;
+                if (merge < 0 || growth < least) {
+                    merge = i;
+                    least = growth;
+                }
+            }
+        }
+        if (merge < 0)
+            break;
+        r = gifRectBounds(dirty[merge], r);
+        dirty[merge] = dirty[--dirtyCount];
+    }
+    dirty[dirtyCount++] = r;
+}
+
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+void GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::markLayer(int i) {
+    markDirty(layers[i].x, layers[i].y, layers[i].width, layers[i].height);
+}
+
+// Back to front by z.  Equal z keeps the order the layers were added
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+void GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::sortLayers(void) {
+    orderCount = 0;
+    for (int i = 0; i < maxLayers; i++) {
+        if (!layers[i].used)
+            continue;
+        int j = orderCount++;
+        while (j > 0 && layers[order[j - 1]].z > layers[i].z) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+}
+
+// Paint each row of a rectangle back to front and send it
+template <int maxLayerWidth, int maxLayerHeight, int maxLayers>
+void GifCompositor<maxLayerWidth, maxLayerHeight, maxLayers>::drawRect(const gif_rect &r) {
+    if (drawRowCallback == 0)
+        return;
+    gif_pixel_t row[COMPOSITOR_ROW_PIXELS];
+    gif_pixel_t back = wirePixel(background);
+    for (int y = r.y; y < r.y + r.h; y++) {
+        for (int x = r.x; x < r.x + r.w; x += COMPOSITOR_ROW_PIXELS) {
+            int n = min(r.x + r.w - x, COMPOSITOR_ROW_PIXELS);
+            for (int i = 0; i < n; i++)
+                row[i] = back;
+            for (int k = 0; k < orderCount; k++) {
+                int li = order[k];
+                const layer_t &layer = layers[li];
+                if (y < layer.y || y >= layer.y + layer.height)
+                    continue;
+                int a = max(x, (int)layer.x), b = min(x + n, layer.x + layer.width);
+                if (a >= b)
+                    continue;
+                const gif_pixel_t *src = layer.image + (y - layer.y) * layer.width + (a - layer.x);
+                gif_pixel_t *dst = row + (a - x);
+                if (layer.keyed) {
+                    gif_pixel_t key = wirePixel(layer.key);
+                    for (int i = 0; i < b - a; i++) {
+                        if (src[i] != key)
+                            dst[i] = src[i];
+                    }
+                } else {
+                    memcpy(dst, src, (b - a) * sizeof(gif_pixel_t));
+                }
+            }
+            (*drawRowCallback)(x, y, row, n);
+        }
+    }
+}
@@ -2,13 +2,14 @@
 #define _GIFDECODER_H_
 
 #define NO_IMAGEDATA 2
-#define USE_PALETTE565
+#define USE_DISPLAY_PALETTE
+#define ROTATE_TILE_ROWS 8  //.kbv most output rows collected for 90 and 270 degree turns.  a byte of flags per column
+#define PAIR_LUT 0  //.kbv 1: 1kB table converts two pixels per load for GIFs of 16 colours or fewer.  measure on the MCU first
 
 #include <stdint.h>
 
 typedef void (*callback)(void);
 typedef void (*pixel_callback)(int16_t x, int16_t y, uint8_t red, uint8_t green, uint8_t blue);
-typedef void (*line_callback)(int16_t x, int16_t y, uint8_t *buf, int16_t wid, uint16_t *palette565, int16_t skip);
 typedef void* (*get_buffer_callback)(void);
 
 typedef bool (*file_seek_callback)(unsigned long position);
@@ -16,17 +17,159 @@ typedef unsigned long (*file_position_callback)(void);
 typedef int (*file_read_callback)(void);
 typedef int (*file_read_block_callback)(void * buffer, int numberOfBytes);
 
+typedef bool (*cache_seek_callback)(unsigned long position);
+typedef int (*cache_read_callback)(void * buffer, int numberOfBytes);
+typedef int (*cache_write_callback)(const void * buffer, int numberOfBytes);
+
 typedef struct rgb_24 {
     uint8_t red;
     uint8_t green;
     uint8_t blue;
 } rgb_24;
 
+// Display pixel formats.  The palette is converted to the format once per colour table
+#define GIF_RGB565      0   // uint16_t
+#define GIF_RGB666      1   // 3 bytes red, green, blue.  6 bits each, left aligned.  18-bit SPI panels
+#define GIF_RGB444      2   // uint16_t 0x0RGB
+#define GIF_RGB332      3   // uint8_t RRRGGGBB
+#define GIF_INDEXED     4   // uint8_t palette index.  For panels with their own colour table
+
+#ifndef GIF_PIXEL_FORMAT
+#define GIF_PIXEL_FORMAT GIF_RGB565
+#endif
+
+typedef struct rgb_666 {
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+    bool operator==(const rgb_666 &c) const { return red == c.red && green == c.green && blue == c.blue; }
+    bool operator!=(const rgb_666 &c) const { return !(*this == c); }
+} rgb_666;
+
+// fromPalette() converts a colour table entry.  fromRGB() converts a blended colour
+// swapped() is the wire order of a 16-bit pixel.  blends is false if pixels can't be averaged
+template <int format> struct GifPixelFormat;
+
+template <> struct GifPixelFormat<GIF_RGB565> {
+    typedef uint16_t pixel_t;
+    static const bool blends = true;
+    static pixel_t fromRGB(uint8_t r, uint8_t g, uint8_t b) { return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3); }
+    static pixel_t fromPalette(int index, uint8_t r, uint8_t g, uint8_t b) { return fromRGB(r, g, b); }
+    static pixel_t swapped(pixel_t c) { return (c << 8) | (c >> 8); }
+};
+
+template <> struct GifPixelFormat<GIF_RGB666> {
+    typedef rgb_666 pixel_t;
+    static const bool blends = true;
+    static pixel_t fromRGB(uint8_t r, uint8_t g, uint8_t b) { pixel_t c = { (uint8_t)(r & 0xFC), (uint8_t)(g & 0xFC), (uint8_t)(b & 0xFC) }; return c; }
+    static pixel_t fromPalette(int index, uint8_t r, uint8_t g, uint8_t b) { return fromRGB(r, g, b); }
+    static pixel_t swapped(pixel_t c) { return c; }
+};
+
+template <> struct GifPixelFormat<GIF_RGB444> {
+    typedef uint16_t pixel_t;
+    static const bool blends = true;
+    static pixel_t fromRGB(uint8_t r, uint8_t g, uint8_t b) { return ((r & 0xF0) << 4) | (g & 0xF0) | (b >> 4); }
+    static pixel_t fromPalette(int index, uint8_t r, uint8_t g, uint8_t b) { return fromRGB(r, g, b); }
+    static pixel_t swapped(pixel_t c) { return (c << 8) | (c >> 8); }
+};
+
+template <> struct GifPixelFormat<GIF_RGB332> {
+    typedef uint8_t pixel_t;
+    static const bool blends = true;
+    static pixel_t fromRGB(uint8_t r, uint8_t g, uint8_t b) { return (r & 0xE0) | ((g & 0xE0) >> 3) | (b >> 6); }
+    static pixel_t fromPalette(int index, uint8_t r, uint8_t g, uint8_t b) { return fromRGB(r, g, b); }
+    static pixel_t swapped(pixel_t c) { return c; }
+};
+
+template <> struct GifPixelFormat<GIF_INDEXED> {
+    typedef uint8_t pixel_t;
+    static const bool blends = false;
+    static pixel_t fromRGB(uint8_t r, uint8_t g, uint8_t b) { return 0; }
+    static pixel_t fromPalette(int index, uint8_t r, uint8_t g, uint8_t b) { return index; }
+    static pixel_t swapped(pixel_t c) { return c; }
+};
+
+typedef GifPixelFormat<GIF_PIXEL_FORMAT> gif_format;
+typedef gif_format::pixel_t gif_pixel_t;
+
+// .kbv pixels setTileBuffer() needs: rows for each column, then the column flags
+#define GIF_TILE_PIXELS(width, rows) ((long)(width) * (rows) + ((width) + sizeof(gif_pixel_t) - 1) / sizeof(gif_pixel_t))
+
+#if GIF_PIXEL_FORMAT == GIF_RGB565 || GIF_PIXEL_FORMAT == GIF_RGB444
+#define GIF_PAIR_TABLES  // two 16-bit pixels fit a uint32_t
+#endif
+
+typedef void (*line_callback)(int16_t x, int16_t y, uint8_t *buf, int16_t wid, gif_pixel_t *palette, int16_t skip);
+typedef void (*row_callback)(int16_t x, int16_t y, gif_pixel_t *buf, int16_t wid);
+typedef void (*block_callback)(int16_t x, int16_t y, int16_t wid, int16_t ht, gif_pixel_t *buf);  // ht rows of wid, packed
+typedef void (*fill_callback)(int16_t x, int16_t y, int16_t wid, int16_t ht, gif_pixel_t color);
+
+typedef struct gif_rect {
+    int16_t x;
+    int16_t y;
+    int16_t w;
+    int16_t h;
+} gif_rect;
+
+// What a GIF in flash holds, worked out on the PC by tools/gif2header.cpp
+typedef struct gif_info_t {
+    int16_t width, height;      // logical screen
+    uint16_t frameCount;
+    uint8_t lzwBits;            // widest LZW code.  lzwMaxBits must be at least this
+    uint8_t pad;
+    uint32_t loopTime;          // ms, as getCycleTime() counts it
+    const uint32_t *frames;     // PROGMEM.  file offset of each frame's first block, | GIF_FRAME_KEY
+} gif_info_t;
+
+#define GIF_FRAME_KEY 0x80000000UL  //.kbv in frames[]: covers the screen, no transparent pixels, palette known.  decoding can start here
+
 // LZW constants
 // NOTE: LZW_MAXBITS should be set to 10 or 11 for small displays, 12 for large displays
 //   all 32x32-pixel GIFs tested work with 11, most work with 10
 //   LZW_MAXBITS = 12 will support all GIFs, but takes 16kB RAM
+//   lzwMaxBits = 0: the decoder has no dictionary of its own.  It uses a gif_lzw_arena
+//   set with setLzwArena().  Decoders that take turns can share one.  Each frame is
+//   decoded start to finish inside one decodeFrame() call
 #define LZW_SIZTABLE  (1 << lzwMaxBits)
+#define LZW_ARENA_BITS 12
+
+typedef struct gif_lzw_arena {
+    uint8_t stack[1 << LZW_ARENA_BITS];
+    uint8_t suffix[1 << LZW_ARENA_BITS];
+    uint16_t prefix[1 << LZW_ARENA_BITS];
+} gif_lzw_arena;
+
+// Frame cache states
+#define GIF_CACHE_OFF     0   // no buffer
+#define GIF_CACHE_WAIT    1   // recording starts with the next loop
+#define GIF_CACHE_RECORD  2
+#define GIF_CACHE_REPLAY  3
+#define GIF_CACHE_FULL    4   // the loop didn't fit.  every loop is decoded
+#define GIF_CACHE_READY   5   // the cache file holds a recording.  replay starts with the next loop
+
+// cache ops
+#define CACHE_OP_FILL       0   // x, y, w, h.  one pixel
+#define CACHE_OP_ROW        1   // x, y, w.  w pixels
+#define CACHE_OP_BLOCK      2   // x, y, w, h.  w * h pixels
+#define CACHE_OP_PALETTE    3   // 256 pixels for the line ops that follow
+#define CACHE_OP_LINE       4   // x, y, w, arg = skip.  w palette indices
+#define CACHE_OP_PIXEL      5   // x, y.  red, green, blue
+#define CACHE_OP_CLEAR      6   // screenClearCallback()
+#define CACHE_OP_FRAME      7   // end of frame.  x, y, w, h = dirty rectangle.  arg = frameDelay
+#define CACHE_OP_LOOP       8   // end of the animation
+
+// display list ops.  A byte stream, 16-bit fields little-endian
+#define LIST_OP_WINDOW     16   // x, y, w, step, skip.  the rows that follow are w wide, step apart
+#define LIST_OP_ROW        17   // w palette indices for the window's next row
+#define LIST_OP_FILL       18   // index, x, y, w, h.  disposal fill in logical screen coordinates
+#define LIST_OP_PALETTE    19   // count, count * rgb.  a colour table
+#define LIST_OP_PALREF     20   // 32-bit offset of an earlier LIST_OP_PALETTE
+#define LIST_OP_CLEAR      21   // screenClearCallback()
+#define LIST_OP_FRAME      22   // end of frame.  frameDelay
+#define LIST_OP_LOOP       23   // end of the animation
+
+#define CACHE_LIST_PALETTES 8   // colour tables the display list looks for repeats of
 
 template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
 class GifDecoder {
@@ -38,12 +181,47 @@ public:
     int getFrameNo(void) { return frameNo; }  //.kbv which frame in animation
     int getFrameCount(void) { return frameCount; }  //.kbv how many frames per complete animation
     int getFrameDelay_ms(void) { return frameDelay * 10; }  //.kbv
+    int getLogicalWidth(void) { return lsdWidth; }  //.kbv
+    int getLogicalHeight(void) { return lsdHeight; }  //.kbv
+    long getFillCount(void) { return fillCount; }  //.kbv solid runs sent as fillRect()
+    long getFillBytesSaved(void) { return fillBytesSaved; }  //.kbv pixel bytes not pushed
+    gif_rect getDirtyRect(void) { return dirtyRect; }  //.kbv pixels sent by the last frame. w == 0 if none
+    long getDiffPixels(void) { return diffPixels; }  //.kbv pixels compared with previous frame
+    long getDiffSkipped(void) { return diffSkipped; }  //.kbv pixels not sent because unchanged
     
     void setScreenClearCallback(callback f);
     void setUpdateScreenCallback(callback f);
     void setDrawPixelCallback(pixel_callback f);
     void setDrawLineCallback(line_callback f);
+    void setDrawRowCallback(row_callback f);  //.kbv opaque runs already converted to display pixels
+    void setDrawBlockCallback(block_callback f, gif_pixel_t *buf, int16_t rows);  //.kbv replaces drawRowCallback.  buf holds rows * maxGifWidth. NULL = off
+    void setBlockLines(int16_t lines) { blockLines = lines; }  //.kbv most rows per block. 0 = as many as fit
+    void setFillRectCallback(fill_callback f);
+    void setFillThreshold(int16_t minRun) { fillThreshold = minRun; }  //.kbv 0 = never fill
+    void setProgressive(bool on);  //.kbv opaque interlaced frames show a coarse picture after the first pass
+    void setGammaTable(const uint8_t *table);  //.kbv 256 entries applied to each channel. NULL = none
+    void setColorMatrix(const int16_t *matrix);  //.kbv 3x3 rows of r, g, b. 256 = 1.0. NULL = none
+    void setBrightness(uint8_t level);  //.kbv 255 = full
+    void setNightMode(bool on, uint8_t level = 32);  //.kbv brightness level while on
+    void setWireOrder(bool bigEndian);  //.kbv 16-bit pixels go out byte-swapped. fill colours stay native
+    void setPairTable(uint32_t *table);  //.kbv 65536 entries (256kB) for any palette.  NULL = none, or PAIR_LUT for 16 colour GIFs
+    void setCompositeBuffer(gif_pixel_t *buf, gif_pixel_t screenColor = gif_pixel_t(), int16_t width = maxGifWidth, int16_t height = maxGifHeight);  //.kbv width * height, rows width apart
+    void setOutputSize(int16_t width, int16_t height, uint8_t *boxBuf = 0);  //.kbv downscale. 0, 0 = logical screen size.  boxBuf: maxGifWidth bytes for a 2x2 box filter.  NULL = nearest pixel
+    void setViewport(int16_t x, int16_t y, int16_t width, int16_t height);  //.kbv x, y appears at 0, 0. width 0 = no viewport
+    bool setOrientation(uint8_t rotation, bool mirrorH = false, bool mirrorV = false);  //.kbv needs a row or block sink, quarter turns a block sink and tile buffer.  false and unchanged if missing
+    void setTileBuffer(gif_pixel_t *buf, int16_t rows);  //.kbv GIF_TILE_PIXELS(maxGifWidth, rows) for quarter turns. NULL = none
     void setStartDrawingCallback(callback f);
+    void setLzwArena(gif_lzw_arena *arena);  //.kbv shared dictionary.  NULL = the decoder's own
+    void setFrameCache(uint8_t *buf, long size, bool displayList = false);  //.kbv later loops replay what the sinks got.  NULL = off
+    void setCacheFile(cache_seek_callback seek, cache_read_callback read, cache_write_callback write, unsigned long start, bool recorded);  //.kbv NULL = RAM only
+    long getCacheUsed(void) { return cacheUsed; }  //.kbv bytes recorded
+    int getCacheState(void) { return cacheState; }  //.kbv GIF_CACHE_xxx
+    bool isReplaying(void) { return cacheState == GIF_CACHE_REPLAY; }  //.kbv frames come from the cache
+    void setKeyframes(uint8_t *buf, long size, int16_t every = 0);  //.kbv records for seekToFrame(). snapshot every n frames. NULL = off
+    int seekToFrame(int n);  //.kbv frame n of loop 1 on the screen.  needs setCompositeBuffer() and a row sink
+    bool setGifInfo(const gif_info_t *info);  //.kbv frame count and restart points from tools/gif2header.  after startDecoding().  false if not this GIF
+    int getKeyframeCount(void) { return keyCount; }  //.kbv snapshots and natural keyframes
+    long getKeyframeUsed(void) { return keyUsed; }  //.kbv bytes recorded
 
     void setFileSeekCallback(file_seek_callback f);
     void setFilePositionCallback(file_position_callback f);
@@ -65,6 +243,66 @@ private:
     void copyImageDataRect(uint8_t *dst, uint8_t *src, int x, int y, int width, int height);
     void fillImageData(uint8_t colorIndex);
     void fillImageDataRect(uint8_t colorIndex, int x, int y, int width, int height);
+    void fillDisplayRect(uint8_t colorIndex, int x, int y, int width, int height);
+    int scaledX(int sx);
+    int scaledY(int sy);
+    int sourceX(int ox);
+    bool frameVisible(int &x0, int &x1);
+    int rowCulled(int y);
+    bool clipToViewport(int &x, int &y, int &wid, int &first);
+    void outputLine(int x, int y, uint8_t *buf, int wid, int skip);
+    void outputScaledLine(int x, int y, uint8_t *buf, int wid, int skip);
+    void outputChangedSpans(int x, int y, uint8_t *buf, int wid, int skip);
+    void outputSpan(int x, int y, uint8_t *buf, int wid, int skip);
+    void pushSpan(int x, int y, uint8_t *buf, int wid, int skip);
+    void outputBoxLine(int x, int y, uint8_t *buf, int wid, int skip);
+    void outputBoxPixels(int x, int y, uint8_t *row0, uint8_t *row1, int wid, int skip);
+    void outputPixelRow(int x, int y, gif_pixel_t *buf, uint8_t *opaque, int wid);
+    void flushOutput(void);
+    void beginOutput(void);
+    void orientRect(int &x, int &y, int &width, int &height);
+    bool clipToOutput(int &x, int &y, int &width, int &height);
+    void sendFill(int x, int y, int width, int height, gif_pixel_t color);
+    void sendPixel(int x, int y, uint8_t pixel);
+    void sendRow(int x, int y, gif_pixel_t *buf, int wid);
+    void flushTile(void);
+    int blockLimit(int wid);
+    void emitRow(int x, int y, gif_pixel_t *buf, int wid);
+    void flushBlock(void);
+    bool hasRowSink(void) { return drawRowCallback || drawBlockCallback; }
+    void growDirtyRect(int x, int y, int width, int height);
+    void convertPalette(void);
+    rgb_24 displayColor(uint8_t pixel);
+    void resetCache(void);
+    void startRecording(void);
+    void dropCache(bool colours = false);
+    bool recordingSinks(void) { return cacheState == GIF_CACHE_RECORD && !cacheList; }
+    bool recordingList(void) { return cacheState == GIF_CACHE_RECORD && cacheList; }
+    bool cacheRoom(long bytes);
+    bool flushChunk(void);
+    bool nextChunk(void);
+    void startReplay(void);
+    long cachePayload(uint8_t op, int w, int h);
+    bool cacheOp(uint8_t op, int x, int y, int w, int h, const void *data, int arg = 0);
+    void cacheLine(int x, int y, uint8_t *buf, int wid, int skip);
+    void cacheClear(void);
+    void cacheFrameEnd(void);
+    void cacheLoopEnd(void);
+    int replayFrame(void);
+    int replaySinks(void);
+    bool listBytes(const void *data, long bytes);
+    void listSpan(int x, int y, uint8_t *buf, int wid, int skip);
+    void listFill(uint8_t colorIndex, int x, int y, int width, int height);
+    void listPalette(void);
+    void replaySpan(int x, int y, uint8_t *buf, int wid, int skip);
+    int replayList(void);
+    void dropKeyframes(void);
+    void keyframeArea(int &w, int &h);
+    void keyframeStart(void);
+    void keyframeEnd(void);
+    void restoreKeyframe(long at);
+    void expandRow(gif_pixel_t *dst, const uint8_t *src, int n, int skip, const gif_pixel_t *under = 0);
+    gif_pixel_t wirePixel(gif_pixel_t color) { return wireOrder ? gif_format::swapped(color) : color; }  //.kbv native <-> wire
     int readIntoBuffer(void *buffer, int numberOfBytes);
     int readWord(void);
     void backUpStream(int n);
@@ -105,14 +343,91 @@ private:
     int cycleTime; //.kbv ms for complete animations
     int frameNo; //.kbv which frame in animation
     int frameCount; //.kbv how many frames per complete animation
+    int16_t fillThreshold; //.kbv shortest run worth a fillRect()
+    long fillCount; //.kbv
+    long fillBytesSaved; //.kbv
+    gif_rect dirtyRect; //.kbv bounding box of everything sent for this frame
+    gif_pixel_t *compositeBuffer; //.kbv what is on the screen.  NULL = no differencing
+    gif_pixel_t compositeColor; //.kbv screen colour before the first frame
+    int16_t compositeWidth, compositeHeight; //.kbv composite size.  output outside it is sent without differencing
+    bool wireOrder; //.kbv 16-bit displayPalette is big-endian
+    long diffPixels; //.kbv
+    long diffSkipped; //.kbv
+    int16_t outWidth; //.kbv scaled output size. 0 = not scaled
+    int16_t outHeight; //.kbv
+    uint8_t *boxRow; //.kbv caller's.  maxGifWidth bytes for the box filter.  NULL = nearest pixel
+    bool progressive; //.kbv repeat interlaced rows downward
+    int16_t viewX, viewY; //.kbv viewport in output coordinates
+    int16_t viewWidth, viewHeight; //.kbv
+    uint8_t orient; //.kbv ORIENT_xxx bits. 0 = as decoded
+    int16_t orientWidth, orientHeight; //.kbv output size before it is turned
+    bool tilePending; //.kbv
+    int16_t tileY, tileX0, tileX1;
+    gif_pixel_t *tileBuf; //.kbv caller's.  column major, tileRows per column
+    uint8_t *tileMask; //.kbv after the columns.  bit per tile row
+    int16_t tileRows; //.kbv
+    int16_t blockLines; //.kbv line budget
+    int16_t blockX, blockY, blockWid, blockHt; //.kbv rows waiting in blockBuf
+    bool blockFromComposite; //.kbv copy the block out of the composite when it is sent
+    long blockPixels; //.kbv changed pixels in the block.  The rest is padding
+    gif_pixel_t *blockBuf; //.kbv caller's.  blockRows * maxGifWidth pixels
+    int16_t blockRows; //.kbv full width rows blockBuf holds.  narrower rows fit more
+    bool boxPending; //.kbv boxRow is waiting for the row below
+    int16_t boxX, boxY, boxWid, boxSkip;
+    uint8_t *cacheBuf; //.kbv frame cache.  NULL = off
+    long cacheSize; //.kbv
+    long cacheUsed; //.kbv bytes recorded
+    long cachePos; //.kbv next op to replay
+    uint8_t cacheState; //.kbv GIF_CACHE_xxx
+    bool cacheStale; //.kbv output settings changed while replaying.  record the next loop again
+    bool cachePalette; //.kbv displayPalette is in the cache
+    gif_pixel_t *cacheLinePalette; //.kbv palette for replayed line ops
+    bool cacheList; //.kbv record palette indices and replay them through the output stage
+    long cachePalettes[CACHE_LIST_PALETTES]; //.kbv offsets of recorded colour tables
+    uint8_t cachePaletteCount; //.kbv
+    long cacheCurPalette; //.kbv colour table in use when the list is replayed.  -1 = none yet
+    long cacheWinPos; //.kbv open window record.  -1 = none
+    int16_t cacheWinX, cacheWinY, cacheWinW, cacheWinSkip; //.kbv
+    int16_t cacheWinStep, cacheWinRows; //.kbv
+    bool cacheNewLoop; //.kbv the next replayed frame is frame 1
+    cache_seek_callback cacheSeek; //.kbv cache file.  the buffer holds one chunk of it
+    cache_read_callback cacheRead;
+    cache_write_callback cacheWrite;
+    unsigned long cacheStart; //.kbv file position of the first chunk
+    bool cacheRecorded; //.kbv the file already holds a complete loop
+    uint8_t *keyBuf; //.kbv keyframe records.  NULL = off
+    long keySize; //.kbv
+    long keyUsed; //.kbv bytes recorded
+    int16_t keyEvery; //.kbv frames between snapshots.  0 = natural keyframes only
+    int16_t keyCount; //.kbv
+    int keyLast; //.kbv latest frame a seek can start at without decoding it
+    bool keyFull; //.kbv no room for another snapshot
+    const gif_info_t *gifInfo; //.kbv frames[] for seekToFrame().  NULL = none
+    bool seeking; //.kbv frames are decoded into the composite.  nothing is sent
+    unsigned long frameStart; //.kbv first block parsed for this frame
+    unsigned long paletteStart; //.kbv file position of the colour table in palette.  0 = none
 //    int frameSize; //.kbv
 
     unsigned long nextFrameTime_ms;
 
     int colorCount;
     rgb_24 palette[256];
-#if defined(USE_PALETTE565)
-    uint16_t palette565[256];
+    const uint8_t *gammaTable; //.kbv
+    int16_t colorMatrix[9]; //.kbv
+    bool useColorMatrix; //.kbv
+    uint8_t brightness = 255; //.kbv
+    uint8_t nightBrightness; //.kbv
+    bool nightMode; //.kbv
+    bool colorTransform; //.kbv a matrix, brightness or gamma is set
+#if defined(USE_DISPLAY_PALETTE)
+    gif_pixel_t displayPalette[256]; //.kbv palette in GIF_PIXEL_FORMAT
+#endif
+#if defined(GIF_PAIR_TABLES)
+#if PAIR_LUT
+    uint32_t pairLut[256]; //.kbv two pixels per entry for palettes of 16 colours or fewer
+#endif
+    uint32_t *pairTable; //.kbv caller's 65536 entry table.  NULL = none
+    uint8_t pairBits; //.kbv pair table for this palette: 4, 8 or 0 = none
 #endif
 
     char tempBuffer[260];
@@ -129,6 +444,9 @@ private:
     callback updateScreenCallback;
     pixel_callback drawPixelCallback;
     line_callback drawLineCallback;
+    row_callback drawRowCallback;
+    block_callback drawBlockCallback;
+    fill_callback fillRectCallback;
     callback startDrawingCallback;
     file_seek_callback fileSeekCallback;
     file_position_callback filePositionCallback;
@@ -153,9 +471,13 @@ private:
     uint8_t *sp;
     uint8_t * temp_buffer;
 
-    uint8_t stack  [LZW_SIZTABLE];
-    uint8_t suffix [LZW_SIZTABLE];
-    uint16_t prefix [LZW_SIZTABLE];
+    static const int lzwBits = lzwMaxBits ? lzwMaxBits : LZW_ARENA_BITS; //.kbv
+    uint8_t stackTable  [LZW_SIZTABLE];
+    uint8_t suffixTable [LZW_SIZTABLE];
+    uint16_t prefixTable [LZW_SIZTABLE];
+    uint8_t *stack = lzwMaxBits ? stackTable : 0; //.kbv own tables or the arena's
+    uint8_t *suffix = lzwMaxBits ? suffixTable : 0;
+    uint16_t *prefix = lzwMaxBits ? prefixTable : 0;
 
     // Masks for 0 .. 16 bits
     unsigned int mask[17] = {
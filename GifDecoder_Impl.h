@@ -35,6 +35,7 @@
 #endif
 
 #include "GifDecoder.h"
+#include "GifExpand.h"
 
 #if GIFDEBUG == 1
 #define DEBUG_SCREEN_DESCRIPTOR                             1
@@ -70,6 +71,8 @@
 #define ERROR_FILENOTGIF           -2
 #define ERROR_BADGIFFORMAT         -3
 #define ERROR_UNKNOWNCONTROLEXT    -4
+#define ERROR_NOLZWARENA           -5
+#define ERROR_CANTSEEK             -6
 
 #define GIFHDRTAGNORM   "GIF87a"  // tag in valid GIF file
 #define GIFHDRTAGNORM1  "GIF89a"  // tag in valid GIF file
@@ -110,6 +113,89 @@ void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setDrawLineCallback(line
     drawLineCallback = f;
 }
 
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setDrawRowCallback(row_callback f) {
+    drawRowCallback = f;
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setDrawBlockCallback(block_callback f, gif_pixel_t *buf, int16_t rows) {
+    // .kbv rows are packed in buf, and blocks from the composite are copied there
+    if (buf == 0 || rows < 1)
+        f = 0;
+    drawBlockCallback = f;
+    blockBuf = f ? buf : 0;
+    blockRows = f ? rows : 0;
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setFillRectCallback(fill_callback f) {
+    fillRectCallback = f;
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setWireOrder(bool bigEndian) {
+    wireOrder = bigEndian;
+    convertPalette();
+    dropCache(true);
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setPairTable(uint32_t *table) {
+#if defined(GIF_PAIR_TABLES)
+    pairTable = table;
+    convertPalette();
+#endif
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setProgressive(bool on) {
+    progressive = on;
+}
+
+// Colour transform.  Changes re-convert the current palette straight away
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setGammaTable(const uint8_t *table) {
+    gammaTable = table;
+    convertPalette();
+    dropCache(true);
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setColorMatrix(const int16_t *matrix) {
+    useColorMatrix = (matrix != 0);
+    if (matrix)
+        memcpy(colorMatrix, matrix, sizeof(colorMatrix));
+    convertPalette();
+    dropCache(true);
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setBrightness(uint8_t level) {
+    brightness = level;
+    convertPalette();
+    dropCache(true);
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setNightMode(bool on, uint8_t level) {
+    nightMode = on;
+    nightBrightness = level;
+    convertPalette();
+    dropCache(true);
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setCompositeBuffer(gif_pixel_t *buf, gif_pixel_t screenColor, int16_t width, int16_t height) {
+    compositeBuffer = buf;
+    compositeColor = screenColor;
+    compositeWidth = (width < maxGifWidth) ? width : maxGifWidth;
+    compositeHeight = (height < maxGifHeight) ? height : maxGifHeight;
+    if (compositeWidth <= 0 || compositeHeight <= 0)
+        compositeBuffer = 0;
+    dropCache();
+}
+
 template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
 void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setScreenClearCallback(callback f) {
     screenClearCallback = f;
@@ -163,24 +249,90 @@ int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::readWord() {
     return (b1 << 8) | b0;
 }
 
+// Build displayPalette from the rgb palette.  Once per colour table, so nothing is converted while drawing
+// Pixel pair tables are built from displayPalette
+// .kbv only the colour table's colorCount entries.  Indices past it show whatever was there
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::convertPalette(void) {
+
+    int level = nightMode ? nightBrightness : brightness;
+    colorTransform = useColorMatrix || level < 255 || gammaTable;
+#if defined(USE_DISPLAY_PALETTE)
+    for (int i = 0; i < colorCount; i++) {
+        rgb_24 c = colorTransform ? displayColor(i) : palette[i];
+        displayPalette[i] = wirePixel(gif_format::fromPalette(i, c.red, c.green, c.blue));
+    }
+#endif
+    cachePalette = false;
+#if defined(GIF_PAIR_TABLES)
+    // .kbv the 64K table takes about as long as a few rows of LZW.  Small tables build colorCount squared pairs.
+    //   Pairs with an index past colorCount keep an old table's entry, so expandRow() sends them singly
+    pairBits = 0;
+    if (pairTable) {
+        gifBuildPairs<8>(pairTable, displayPalette, colorCount);
+        pairBits = 8;
+    }
+#if PAIR_LUT
+    else if (colorCount <= 16) {
+        gifBuildPairs<4>(pairLut, displayPalette, colorCount);
+        pairBits = 4;
+    }
+#endif
+#endif
+}
+
+// Palette entry pixel after the colour transform
+// .kbv colour matrix, then brightness, then gamma.  Pixel callbacks and the box filter call it per pixel
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+rgb_24 GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::displayColor(uint8_t pixel) {
+
+    rgb_24 c = palette[pixel];
+    if (!colorTransform)
+        return c;
+    int level = nightMode ? nightBrightness : brightness;
+    int r = c.red;
+    int g = c.green;
+    int b = c.blue;
+    if (useColorMatrix) {
+        const int16_t *m = colorMatrix;
+        int32_t rr = ((int32_t)m[0] * r + (int32_t)m[1] * g + (int32_t)m[2] * b) >> 8;
+        int32_t gg = ((int32_t)m[3] * r + (int32_t)m[4] * g + (int32_t)m[5] * b) >> 8;
+        int32_t bb = ((int32_t)m[6] * r + (int32_t)m[7] * g + (int32_t)m[8] * b) >> 8;
+        r = (rr < 0) ? 0 : (rr > 255) ? 255 : rr;
+        g = (gg < 0) ? 0 : (gg > 255) ? 255 : gg;
+        b = (bb < 0) ? 0 : (bb > 255) ? 255 : bb;
+    }
+    if (level < 255) {
+        r = (r * (level + 1)) >> 8;
+        g = (g * (level + 1)) >> 8;
+        b = (b * (level + 1)) >> 8;
+    }
+    if (gammaTable) {
+        r = gammaTable[r];
+        g = gammaTable[g];
+        b = gammaTable[b];
+    }
+    c.red = r;
+    c.green = g;
+    c.blue = b;
+    return c;
+}
+
 // Read the specified number of bytes into the specified buffer
 template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
 int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::readIntoBuffer(void *buffer, int numberOfBytes) {
 
+    if (buffer == palette)
+        paletteStart = filePositionCallback();  // .kbv keyframes read the colour table again from here
     int result = fileReadBlockCallback(buffer, numberOfBytes);
     if (result == -1) {
         Serial.println("Read error or EOF occurred");
     }
-#if defined(USE_PALETTE565)
     if (buffer == palette) {
-        for (int i = 0; i < 256; i++) {
-            uint8_t r = palette[i].red;
-            uint8_t g = palette[i].green;
-            uint8_t b = palette[i].blue;
-            palette565[i] = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | ((b & 0xF8) >> 3);
-        }
+        convertPalette();
+        if (recordingList())
+            listPalette();
     }
-#endif
     return result;
 }
 
@@ -475,22 +627,8 @@ void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::parseTableBasedImage() {
     Serial.println((tbiInterlaced != 0) ? "Yes" : "No");
 #endif
 
-    // Does this image have a local color table ?
-    bool localColorTable =  ((tbiPackedBits & COLORTBLFLAG) != 0);
-
-    if (localColorTable) {
-        int colorBits = ((tbiPackedBits & 7) + 1);
-        colorCount = 1 << colorBits;
-
-#if GIFDEBUG == 1 && DEBUG_PROCESSING_TBI_DESC_LOCAL_COLOR_TABLE == 1
-        Serial.print("Local color table with ");
-        Serial.print(colorCount);
-        Serial.println(" colors present");
-#endif
-        // Read colors into palette
-        int colorTableBytes = sizeof(rgb_24) * colorCount;
-        readIntoBuffer(palette, colorTableBytes);
-    }
+    if (keyBuf && !keyFrame)
+        keyframeStart();
 
     // One time initialization of imageData before first frame
     if (keyFrame) {
@@ -510,14 +648,23 @@ void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::parseTableBasedImage() {
     }
     // Don't clear matrix screen for these disposal methods
     if ((prevDisposalMethod != DISPOSAL_NONE) && (prevDisposalMethod != DISPOSAL_LEAVE)) {
-        if (screenClearCallback)
+        if (screenClearCallback && !seeking) {
             (*screenClearCallback)();
+            if (cacheState == GIF_CACHE_RECORD)
+                cacheClear();
+        }
     }
 
+    beginOutput();
+
     // Process previous disposal method
+    // .kbv before any local color table replaces the previous frame's palette
     if (prevDisposalMethod == DISPOSAL_BACKGROUND) {
         // Fill portion of imageData with previous background color
         fillImageDataRect(prevBackgroundIndex, rectX, rectY, rectWidth, rectHeight);
+#if NO_IMAGEDATA >= 2
+        fillDisplayRect(prevBackgroundIndex, rectX, rectY, rectWidth, rectHeight);
+#endif
     }
     else if (prevDisposalMethod == DISPOSAL_RESTORE) {
 #if NO_IMAGEDATA < 1
@@ -559,6 +706,23 @@ void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::parseTableBasedImage() {
         }
     }
 
+    // Does this image have a local color table ?
+    bool localColorTable =  ((tbiPackedBits & COLORTBLFLAG) != 0);
+
+    if (localColorTable) {
+        int colorBits = ((tbiPackedBits & 7) + 1);
+        colorCount = 1 << colorBits;
+
+#if GIFDEBUG == 1 && DEBUG_PROCESSING_TBI_DESC_LOCAL_COLOR_TABLE == 1
+        Serial.print("Local color table with ");
+        Serial.print(colorCount);
+        Serial.println(" colors present");
+#endif
+        // Read colors into palette
+        int colorTableBytes = sizeof(rgb_24) * colorCount;
+        readIntoBuffer(palette, colorTableBytes);
+    }
+
     // Read the min LZW code size
     lzwCodeSize = readByte();
 
@@ -619,6 +783,10 @@ void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::parseTableBasedImage() {
 
     // Decompress LZW data and display the frame
     decompressAndDisplayFrame(filePositionAfter);
+    if (cacheState == GIF_CACHE_RECORD)
+        cacheFrameEnd();
+    if (keyBuf)
+        keyframeEnd();
 
     // Graphic control extension is for a single frame
     transparentColorIndex = NO_TRANSPARENT_INDEX;
@@ -630,6 +798,8 @@ template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
 int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::parseData() {
     if (nextFrameTime_ms > millis())
         return ERROR_WAITING;
+    if (keyBuf)
+        frameStart = filePositionCallback();
 
 #if GIFDEBUG == 1 && DEBUG_PARSING_DATA == 1
     Serial.println("\nParsing Data Block");
@@ -710,6 +880,21 @@ int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::startDecoding(void) {
     prevDisposalMethod = DISPOSAL_NONE;
     transparentColorIndex = NO_TRANSPARENT_INDEX;
     nextFrameTime_ms = 0;
+    fillCount = fillBytesSaved = 0;
+    diffPixels = diffSkipped = 0;
+    resetCache();
+    dropKeyframes();
+    gifInfo = 0;
+    seeking = false;
+    paletteStart = 0;
+    if (compositeBuffer) {
+        for (long i = 0; i < (long)compositeWidth * compositeHeight; i++)
+            compositeBuffer[i] = wirePixel(compositeColor);
+    }
+    if (stack == 0) {
+        Serial.println("No LZW arena");
+        return ERROR_NOLZWARENA;
+    }
     fileSeekCallback(0);
 
     // Validate the header
@@ -730,6 +915,9 @@ int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::startDecoding(void) {
 
 template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
 int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::decodeFrame(void) {
+    if (cacheState == GIF_CACHE_REPLAY)
+        return replayFrame();
+
     // Parse gif data
     int result = parseData();
     if (result < ERROR_NONE) {
@@ -740,6 +928,7 @@ int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::decodeFrame(void) {
     }
 
     if (result == ERROR_DONE_PARSING) {
+        cacheLoopEnd();
         //startDecoding();
         // Initialize variables like with a new file
         keyFrame = true;
@@ -827,8 +1016,10 @@ void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::decompressAndDisplayFram
             }
 
             // Pixel not transparent so get color from palette and draw the pixel
-            if (drawPixelCallback)
-                (*drawPixelCallback)(x, y, palette[pixel].red, palette[pixel].green, palette[pixel].blue);
+            if (drawPixelCallback) {
+                rgb_24 c = displayColor(pixel);
+                (*drawPixelCallback)(x, y, c.red, c.green, c.blue);
+            }
         }
     }
 #else
@@ -857,32 +1048,38 @@ void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::decompressAndDisplayFram
     Serial.print(buf);
     //delay(10);    //allow Serial to complete @ 115200 baud.  Serial ISR() should be trivial. 
 #endif
-    for (int state = 0; state < 4; state++) {
+    // .kbv source columns x0..x1 are stored.  Frames outside the viewport are not decoded at all
+    int x0 = tbiImageX, x1 = tbiImageX + tbiWidth;
+    bool visible = frameVisible(x0, x1);
+    // .kbv progressive preview repeats each interlaced row down to the next row of a later pass
+    // transparent frames would leave the copies showing through, so they are drawn normally
+    bool preview = progressive && tbiInterlaced && transparentColorIndex == NO_TRANSPARENT_INDEX;
+    for (int state = 0; visible && state < 4; state++) {
         if (tbiInterlaced == 0) state = 4; //regular does one pass
+        int reps = (preview) ? ((state == 0) ? 8 : incs[state] / 2) : 1;
         for (int line = starts[state]; line < tbiHeight; line += incs[state]) {
-            if (disposalMethod == DISPOSAL_BACKGROUND) memset(imageBuf, prevBackgroundIndex, maxGifWidth);
-//            int align = (lsdWidth > maxGifWidth) ? lsdWidth - maxGifWidth : 0;
-//            int ofs = tbiImageX - align;
-//            uint8_t *dst = (ofs < 0) ? imageBuf : imageBuf + ofs;
-//            align = (ofs < 0) ? -ofs : 0;
-            int align = 0;
-            int len = lzw_decode(imageBuf + tbiImageX, tbiWidth, imageBuf + maxGifWidth - 1, align);
-            if (len != tbiWidth) Serial.println(len);
-            int xofs = (disposalMethod == DISPOSAL_BACKGROUND) ? 0 : tbiImageX;
-            int wid = (disposalMethod == DISPOSAL_BACKGROUND) ? lsdWidth : tbiWidth;
-            int skip = (disposalMethod == DISPOSAL_BACKGROUND) ? -1 : transparentColorIndex;;
-            if (drawLineCallback) {
-                (*drawLineCallback)(xofs, line + tbiImageY, imageBuf + xofs, wid, palette565, skip);
-            } else if (drawPixelCallback) {
-                for (int x = 0; x < wid; x++) {
-                    uint8_t pixel = imageBuf[x + xofs];
-                    if ((pixel != skip))
-                        (*drawPixelCallback)(x + xofs, line + tbiImageY,
-                                             palette[pixel].red, palette[pixel].green, palette[pixel].blue);
-                }
+            int n = (line + reps > tbiHeight) ? tbiHeight - line : reps;
+            int cull = rowCulled(line + tbiImageY);
+            for (int k = 1; k < n && cull < 0; k++) {
+                int c = rowCulled(line + tbiImageY + k);
+                if (c == 0) cull = 0;
+                else if (c > 0) break;
             }
+            if (cull > 0 && state >= 3)
+                break;      // .kbv nothing below is visible.  jump to the end of the frame
+            if (cull) {
+                lzw_decode(imageBuf, tbiWidth, imageBuf);   // .kbv expand but store nothing
+                continue;
+            }
+            int len = lzw_decode(imageBuf + x0, tbiWidth, imageBuf + x1, x0 - tbiImageX);
+            if (len != tbiWidth) Serial.println(len);
+            // .kbv previous frame is already disposed.  Only draw this frame's own rectangle
+            int skip = transparentColorIndex;
+            for (int k = 0; k < n; k++)
+                outputLine(x0, line + tbiImageY + k, imageBuf + x0, x1 - x0, skip);
         }
     }
+    flushOutput();
     // LZW doesn't parse through all the data, manually set position
     fileSeekCallback(filePositionAfter);
 #if GIFDEBUG > 3
@@ -0,0 +1,227 @@
+#ifndef _GIFEXPAND_H_
+#define _GIFEXPAND_H_
+
+// Palette expansion.  A row of colour indices becomes a row of display pixels
+//   gifExpand(dst, src, n, palette, skip, under)
+//     dst[i] = palette[src[i]]
+//     if under is not NULL, pixels equal to skip take under[i] instead
+// .kbv the vector kernels are chosen at compile time from the target's feature macros
+//   Helium (Cortex-M55, M85)  gather of 8 halfwords
+//   NEON (AArch64)            the 256 entry palette sits in 16 table registers
+//   AVX2                      gather of 8 words
+//   SSE4.1                    byte shuffle when a block only uses colours 0-15
+//                             slower than scalar on most GIFs, so gifExpand() doesn't pick it
+// Only 16-bit pixels are vectorised.  Other formats and row tails use the scalar loop
+// #define GIF_EXPAND_SCALAR to turn the vector kernels off
+
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(GIF_EXPAND_SCALAR)
+#if defined(__ARM_FEATURE_MVE) && (__ARM_FEATURE_MVE & 1)
+#include <arm_mve.h>
+#define GIF_EXPAND_HELIUM
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GIF_EXPAND_NEON
+#elif defined(__SSE4_1__)
+#include <immintrin.h>
+#define GIF_EXPAND_SSE41
+#if defined(__AVX2__)
+#define GIF_EXPAND_AVX2
+#endif
+#endif
+#endif
+
+template <class pixel_t>
+static inline void gifExpandScalar(pixel_t *dst, const uint8_t *src, int n, const pixel_t *palette, int skip, const pixel_t *under) {
+    if (under == 0 || skip < 0 || skip > 255) {
+        for (int i = 0; i < n; i++)
+            dst[i] = palette[src[i]];
+    } else {
+        for (int i = 0; i < n; i++) {
+            uint8_t pixel = src[i];
+            dst[i] = (pixel == skip) ? under[i] : palette[pixel];
+        }
+    }
+}
+
+#if defined(GIF_EXPAND_HELIUM)
+static inline void gifExpandHelium(uint16_t *dst, const uint8_t *src, int n, const uint16_t *palette, int skip, const uint16_t *under) {
+    if (skip < 0 || skip > 255) under = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t idx = vldrbq_u16(src + i);
+        uint16x8_t v = vldrhq_gather_shifted_offset_u16(palette, idx);
+        if (under) {
+            mve_pred16_t p = vcmpeqq_n_u16(idx, (uint16_t)skip);
+            v = vpselq_u16(vld1q_u16(under + i), v, p);
+        }
+        vst1q_u16(dst + i, v);
+    }
+    gifExpandScalar(dst + i, src + i, n - i, palette, skip, under ? under + i : 0);
+}
+#endif
+
+#if defined(GIF_EXPAND_NEON)
+// .kbv TBL looks up 64 bytes at a time.  Out of range indices leave TBX lanes alone,
+//   so four lookups with idx, idx-64, idx-128, idx-192 cover the palette
+static inline void gifExpandNEON(uint16_t *dst, const uint8_t *src, int n, const uint16_t *palette, int skip, const uint16_t *under) {
+    if (skip < 0 || skip > 255) under = 0;
+    int i = 0;
+    if (n >= 64) {
+        uint8x16x4_t lo[4], hi[4];
+        for (int k = 0; k < 4; k++) {
+            for (int j = 0; j < 4; j++) {
+                uint8x16x2_t p = vld2q_u8((const uint8_t *)(palette + 64 * k + 16 * j));
+                lo[k].val[j] = p.val[0];
+                hi[k].val[j] = p.val[1];
+            }
+        }
+        uint8x16_t k64 = vdupq_n_u8(64), k128 = vdupq_n_u8(128), k192 = vdupq_n_u8(192);
+        uint8x16_t kskip = vdupq_n_u8((uint8_t)skip);
+        for (; i + 16 <= n; i += 16) {
+            uint8x16_t idx = vld1q_u8(src + i);
+            uint8x16_t i1 = vsubq_u8(idx, k64), i2 = vsubq_u8(idx, k128), i3 = vsubq_u8(idx, k192);
+            uint8x16x2_t out;
+            out.val[0] = vqtbx4q_u8(vqtbx4q_u8(vqtbx4q_u8(vqtbl4q_u8(lo[0], idx), lo[1], i1), lo[2], i2), lo[3], i3);
+            out.val[1] = vqtbx4q_u8(vqtbx4q_u8(vqtbx4q_u8(vqtbl4q_u8(hi[0], idx), hi[1], i1), hi[2], i2), hi[3], i3);
+            if (under) {
+                uint8x16_t m = vceqq_u8(idx, kskip);
+                uint8x16x2_t u = vld2q_u8((const uint8_t *)(under + i));
+                out.val[0] = vbslq_u8(m, u.val[0], out.val[0]);
+                out.val[1] = vbslq_u8(m, u.val[1], out.val[1]);
+            }
+            vst2q_u8((uint8_t *)(dst + i), out);
+        }
+    }
+    gifExpandScalar(dst + i, src + i, n - i, palette, skip, under ? under + i : 0);
+}
+#endif
+
+#if defined(GIF_EXPAND_AVX2)
+// .kbv a 32-bit gather at 2-byte scale would read past palette[255].  Those lanes are
+//   masked off and take palette[255] from the source operand instead
+static inline void gifExpandAVX2(uint16_t *dst, const uint8_t *src, int n, const uint16_t *palette, int skip, const uint16_t *under) {
+    if (skip < 0 || skip > 255) under = 0;
+    const __m256i k255 = _mm256_set1_epi32(255), kffff = _mm256_set1_epi32(0xFFFF);
+    const __m256i last = _mm256_set1_epi32(palette[255]), kskip = _mm256_set1_epi32(skip);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+        __m256i keep = _mm256_andnot_si256(_mm256_cmpeq_epi32(idx, k255), _mm256_set1_epi32(-1));
+        __m256i v = _mm256_mask_i32gather_epi32(last, (const int *)palette, idx, keep, 2);
+        v = _mm256_and_si256(v, kffff);
+        __m128i out = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        if (under) {
+            __m256i m = _mm256_cmpeq_epi32(idx, kskip);
+            __m128i m16 = _mm_packs_epi32(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+            out = _mm_blendv_epi8(out, _mm_loadu_si128((const __m128i *)(under + i)), m16);
+        }
+        _mm_storeu_si128((__m128i *)(dst + i), out);
+    }
+    gifExpandScalar(dst + i, src + i, n - i, palette, skip, under ? under + i : 0);
+}
+#endif
+
+#if defined(GIF_EXPAND_SSE41)
+// .kbv PSHUFB has a 16 byte table.  Blocks that use any colour above 15 go through the scalar loop
+static inline void gifExpandSSE41(uint16_t *dst, const uint8_t *src, int n, const uint16_t *palette, int skip, const uint16_t *under) {
+    if (skip < 0 || skip > 255) under = 0;
+    int i = 0;
+    if (n >= 16) {
+        __m128i p0 = _mm_loadu_si128((const __m128i *)palette), p1 = _mm_loadu_si128((const __m128i *)(palette + 8));
+        const __m128i kff = _mm_set1_epi16(0xFF), kf0 = _mm_set1_epi8((char)0xF0);
+        __m128i lo = _mm_packus_epi16(_mm_and_si128(p0, kff), _mm_and_si128(p1, kff));
+        __m128i hi = _mm_packus_epi16(_mm_srli_epi16(p0, 8), _mm_srli_epi16(p1, 8));
+        __m128i kskip = _mm_set1_epi8((char)skip);
+        for (; i + 16 <= n; i += 16) {
+            __m128i idx = _mm_loadu_si128((const __m128i *)(src + i));
+            if (!_mm_testz_si128(idx, kf0)) {
+                gifExpandScalar(dst + i, src + i, 16, palette, skip, under ? under + i : 0);
+                continue;
+            }
+            __m128i l = _mm_shuffle_epi8(lo, idx), h = _mm_shuffle_epi8(hi, idx);
+            __m128i out0 = _mm_unpacklo_epi8(l, h), out1 = _mm_unpackhi_epi8(l, h);
+            if (under) {
+                __m128i m = _mm_cmpeq_epi8(idx, kskip);
+                __m128i m0 = _mm_unpacklo_epi8(m, m), m1 = _mm_unpackhi_epi8(m, m);
+                out0 = _mm_blendv_epi8(out0, _mm_loadu_si128((const __m128i *)(under + i)), m0);
+                out1 = _mm_blendv_epi8(out1, _mm_loadu_si128((const __m128i *)(under + i + 8)), m1);
+            }
+            _mm_storeu_si128((__m128i *)(dst + i), out0);
+            _mm_storeu_si128((__m128i *)(dst + i + 8), out1);
+        }
+    }
+    gifExpandScalar(dst + i, src + i, n - i, palette, skip, under ? under + i : 0);
+}
+#endif
+
+template <class pixel_t>
+static inline void gifExpand(pixel_t *dst, const uint8_t *src, int n, const pixel_t *palette, int skip = -1, const pixel_t *under = 0) {
+    gifExpandScalar(dst, src, n, palette, skip, under);
+}
+
+static inline void gifExpand(uint16_t *dst, const uint8_t *src, int n, const uint16_t *palette, int skip = -1, const uint16_t *under = 0) {
+#if defined(GIF_EXPAND_HELIUM)
+    gifExpandHelium(dst, src, n, palette, skip, under);
+#elif defined(GIF_EXPAND_NEON)
+    gifExpandNEON(dst, src, n, palette, skip, under);
+#elif defined(GIF_EXPAND_AVX2)
+    gifExpandAVX2(dst, src, n, palette, skip, under);
+#else
+    gifExpandScalar(dst, src, n, palette, skip, under);
+#endif
+}
+
+// Pixel pair tables.  One 32-bit load and store converts two pixels
+//   bits 4: 256 entries for palettes of 16 colours or fewer.  key (a << 4) | b
+//   bits 8: 65536 entries (256kB) for any palette.  key a | (b << 8)
+template <int bits>
+static inline int gifPairKey(int a, int b) {
+    return (bits == 4) ? (a << 4) | b : a | (b << 8);
+}
+
+template <int bits>
+static inline void gifBuildPairs(uint32_t *pairs, const uint16_t *palette, int count = 1 << bits) {
+    if (count > (1 << bits))
+        count = 1 << bits;
+    for (int b = 0; b < count; b++) {
+        for (int a = 0; a < count; a++) {
+            uint16_t two[2] = { palette[a], palette[b] };
+            memcpy(&pairs[gifPairKey<bits>(a, b)], two, sizeof(two));
+        }
+    }
+}
+
+// .kbv pairs with a transparent pixel, or a colour past the count gifBuildPairs() was given, are
+//   looked up singly.  count is a power of 2, as colour tables are
+template <int bits>
+static inline void gifExpandPairs(uint16_t *dst, const uint8_t *src, int n, const uint16_t *palette, const uint32_t *pairs, int skip = -1, const uint16_t *under = 0, int count = 1 << bits) {
+    if (skip < 0 || skip > 255) under = 0;
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        int a = src[i], b = src[i + 1];
+        if ((a | b) >= count || (under && (a == skip || b == skip))) {
+            dst[i] = (under && a == skip) ? under[i] : palette[a];
+            dst[i + 1] = (under && b == skip) ? under[i + 1] : palette[b];
+            continue;
+        }
+        uint32_t two = pairs[gifPairKey<bits>(a, b)];
+        memcpy(dst + i, &two, sizeof(two));
+    }
+    gifExpandScalar(dst + i, src + i, n - i, palette, skip, under ? under + i : 0);
+}
+
+// Length of the run at src that is (opaque) or isn't (!opaque) the skip index
+static inline int gifRunLength(const uint8_t *src, int n, int skip, bool opaque) {
+    if (opaque) {
+        const uint8_t *p = (skip < 0 || skip > 255) ? 0 : (const uint8_t *)memchr(src, skip, n);
+        return p ? p - src : n;
+    }
+    int i = 0;
+    while (i < n && src[i] == skip) i++;
+    return i;
+}
+
+#endif
@@ -0,0 +1,317 @@
+/*
+    Animated GIFs Display Code for SmartMatrix and 32x32 RGB LED Panels
+
+    This file contains the keyframes for seekToFrame().  While loop 1 plays, the decoder
+    keeps records in the caller's buffer of where it can start decoding again:
+    snapshots: the composite every n frames, packed, with the decoder state after the frame
+    natural keyframes: frames that cover the screen with no transparent pixels.  Nothing
+      before them shows, so only the file position is kept
+    A seek restores the latest record at or before the frame, decodes the frames after it
+    into the composite without sending them, and then sends the whole composite once.
+
+    Record layout: a gif_keyframe followed by its packed pixels, padded to 4 bytes.
+    Pixels are the composite's, rows of the output before it is turned.  Each row is a
+    uint16_t count with the top bit set and one pixel for a run, or a count of pixels
+    .kbv the decoder keeps no palette indices (NO_IMAGEDATA 2), so snapshots are display pixels.
+      Colour and output settings drop them, as they drop the frame cache
+*/
+
+#if defined (ARDUINO)
+#include <Arduino.h>
+#elif defined (SPARK)
+#include "application.h"
+#endif
+
+#include "GifDecoder.h"
+
+typedef struct gif_keyframe {
+    uint16_t frameNo;       // frame on the screen.  natural keyframes: the frame before
+    uint16_t delay;         // frameDelay
+    uint8_t disposal;       // prevDisposalMethod
+    uint8_t background;     // prevBackgroundIndex
+    uint16_t colorCount;
+    int16_t rectX, rectY, rectWidth, rectHeight;
+    uint32_t filePos;       // next block to parse
+    uint32_t palettePos;    // colour table in palette.  0 = none read yet
+    uint32_t bytes;         // packed pixels that follow.  0 = natural keyframe
+} gif_keyframe;
+
+// Pack n pixels.  Bytes written, or -1 if they don't fit in room
+template <typename T>
+static long keyPackRow(uint8_t *dst, long room, const T *src, int n) {
+    long used = 0;
+    for (int i = 0; i < n; ) {
+        int j = i + 1;
+        while (j < n && j - i < 0x7FFF && src[j] == src[i])
+            j++;
+        uint16_t count;
+        const T *from = src + i;
+        int pixels = 1;
+        if (j - i >= 3) {
+            count = 0x8000 | (j - i);
+        } else {
+            // .kbv literals run until three pixels in a row match
+            for (j = i + 1; j < n && j - i < 0x7FFF; j++) {
+                if (j + 2 < n && src[j] == src[j + 1] && src[j] == src[j + 2])
+                    break;
+            }
+            count = pixels = j - i;
+        }
+        long bytes = sizeof(count) + (long)pixels * sizeof(T);
+        if (used + bytes > room)
+            return -1;
+        memcpy(dst + used, &count, sizeof(count));
+        memcpy(dst + used + sizeof(count), from, pixels * sizeof(T));
+        used += bytes;
+        i = j;
+    }
+    return used;
+}
+
+// Unpack n pixels.  Bytes read
+template <typename T>
+static long keyUnpackRow(T *dst, const uint8_t *src, int n) {
+    long used = 0;
+    for (int i = 0; i < n; ) {
+        uint16_t count;
+        memcpy(&count, src + used, sizeof(count));
+        used += sizeof(count);
+        int k = count & 0x7FFF;
+        if (count & 0x8000) {
+            T c;
+            memcpy(&c, src + used, sizeof(T));
+            used += sizeof(T);
+            while (k--)
+                dst[i++] = c;
+        } else {
+            memcpy(dst + i, src + used, k * sizeof(T));
+            used += (long)k * sizeof(T);
+            i += k;
+        }
+    }
+    return used;
+}
+
+// Snapshot every n frames.  0 = natural keyframes only.  Records so far are dropped.
+// seekToFrame() needs a composite and a row or block callback
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setKeyframes(uint8_t *buf, long size, int16_t every) {
+#if NO_IMAGEDATA < 2
+    buf = 0;    // .kbv imageData would have to be kept as well
+#endif
+    keyBuf = buf;
+    keySize = buf ? size : 0;
+    keyEvery = every;
+    dropKeyframes();
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::dropKeyframes(void) {
+    keyUsed = 0;
+    keyCount = 0;
+    keyLast = 0;
+    keyFull = false;
+}
+
+// Frame count and restart points of the GIF just started, from the table tools/gif2header makes.
+// seekToFrame() can start at a frame marked GIF_FRAME_KEY, even one loop 1 has not reached
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+bool GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setGifInfo(const gif_info_t *info) {
+    gifInfo = 0;
+    if (info == 0 || info->width != lsdWidth || info->height != lsdHeight || info->frameCount == 0)
+        return false;
+    gifInfo = info;
+    frameCount = info->frameCount;
+    return true;
+}
+
+// The part of the composite that is on the screen.  Call after beginOutput()
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::keyframeArea(int &w, int &h) {
+    w = (orientWidth < compositeWidth) ? orientWidth : compositeWidth;
+    h = (orientHeight < compositeHeight) ? orientHeight : compositeHeight;
+    if (w < 0) w = 0;
+    if (h < 0) h = 0;
+}
+
+// After the image descriptor, before the previous frame is disposed of.
+// A frame that covers the logical screen with no transparent pixels is a natural keyframe
+// .kbv only loop 1 is recorded.  Later loops start with the last frame on the screen
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::keyframeStart(void) {
+    if (cycleNo != 1 || frameNo <= keyLast || keyUsed + (long)sizeof(gif_keyframe) > keySize)
+        return;
+    if (tbiImageX > 0 || tbiImageY > 0 || tbiWidth < lsdWidth || tbiHeight < lsdHeight
+            || transparentColorIndex != NO_TRANSPARENT_INDEX)
+        return;
+    gif_keyframe k;
+    memset(&k, 0, sizeof(k));
+    k.frameNo = frameNo;
+    k.disposal = DISPOSAL_NONE;
+    k.colorCount = colorCount;
+    k.filePos = frameStart;
+    k.palettePos = paletteStart;
+    memcpy(keyBuf + keyUsed, &k, sizeof(k));
+    keyUsed += sizeof(k);
+    keyCount++;
+    keyLast = frameNo + 1;
+}
+
+// After a frame.  Snapshot the composite if keyEvery frames have gone by since the last record
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::keyframeEnd(void) {
+    if (cycleNo != 1 || keyFull || keyEvery <= 0 || frameNo - keyLast < keyEvery || compositeBuffer == 0)
+        return;
+    int w, h;
+    keyframeArea(w, h);
+    long room = keySize - keyUsed - (long)sizeof(gif_keyframe);
+    uint8_t *p = keyBuf + keyUsed + sizeof(gif_keyframe);
+    long bytes = 0;
+    for (int y = 0; y < h && room >= 0; y++) {
+        long n = keyPackRow(p + bytes, room - bytes, compositeBuffer + y * compositeWidth, w);
+        if (n < 0) {
+            room = -1;
+            break;
+        }
+        bytes += n;
+    }
+    if (room < 0 || ((bytes + 3) & ~3) > room) {
+        keyFull = true;     // .kbv natural keyframes are still recorded
+        return;
+    }
+    if (bytes == 0)
+        return;
+    gif_keyframe k;
+    k.frameNo = frameNo;
+    k.delay = frameDelay;
+    k.disposal = prevDisposalMethod;
+    k.background = prevBackgroundIndex;
+    k.colorCount = colorCount;
+    k.rectX = rectX;
+    k.rectY = rectY;
+    k.rectWidth = rectWidth;
+    k.rectHeight = rectHeight;
+    k.filePos = filePositionCallback();
+    k.palettePos = paletteStart;
+    k.bytes = bytes;
+    memcpy(keyBuf + keyUsed, &k, sizeof(k));
+    keyUsed += sizeof(k) + ((bytes + 3) & ~3);
+    keyCount++;
+    keyLast = frameNo;
+}
+
+// Put the decoder back to the record at keyBuf + at.  Snapshots are unpacked into the composite
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::restoreKeyframe(long at) {
+    gif_keyframe k;
+    memcpy(&k, keyBuf + at, sizeof(k));
+    if (k.bytes) {
+        int w, h;
+        keyframeArea(w, h);
+        const uint8_t *p = keyBuf + at + sizeof(k);
+        for (int y = 0; y < h; y++)
+            p += keyUnpackRow(compositeBuffer + y * compositeWidth, p, w);
+    }
+    keyFrame = false;
+    frameNo = k.frameNo;
+    frameDelay = k.delay;
+    prevDisposalMethod = k.disposal;
+    prevBackgroundIndex = k.background;
+    rectX = k.rectX;
+    rectY = k.rectY;
+    rectWidth = k.rectWidth;
+    rectHeight = k.rectHeight;
+    if (k.palettePos) {
+        colorCount = k.colorCount;
+        fileSeekCallback(k.palettePos);
+        readIntoBuffer(palette, sizeof(rgb_24) * colorCount);
+    }
+    fileSeekCallback(k.filePos);
+}
+
+// Put frame n of loop 1 on the screen.  0 = the screen before frame 1.
+// The latest record or setGifInfo() restart point at or before n is used, or the decoder
+// carries on from where it is if that is nearer.  The frames in between are decoded into the composite without being
+// sent, then the whole composite is sent.  The next decodeFrame() is frame n + 1.
+// ERROR_DONE_PARSING: the GIF has fewer than n frames.  The last one is on the screen
+// .kbv cycle time is left as it was.  A frame cache is given up for this GIF, as replay
+//   and recording follow the file from frame 1
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::seekToFrame(int n) {
+    if (compositeBuffer == 0 || !hasRowSink() || stack == 0 || n < 0)
+        return ERROR_CANTSEEK;
+    if (cacheState != GIF_CACHE_OFF)
+        cacheState = GIF_CACHE_FULL;
+    beginOutput();
+
+    // the latest record frame n can be decoded from.  Natural keyframes are decoded again
+    long at = -1;
+    int from = 0;
+    for (long pos = 0; pos < keyUsed; ) {
+        gif_keyframe k;
+        memcpy(&k, keyBuf + pos, sizeof(k));
+        if (k.frameNo + (k.bytes == 0) > n)
+            break;
+        at = pos;
+        from = k.frameNo;
+        pos += sizeof(k) + ((k.bytes + 3) & ~3);
+    }
+    // .kbv or a marked frame from setGifInfo(), if it is later.  Frame i + 1 starts at frames[i]
+    uint32_t start = 0;
+    if (gifInfo) {
+        for (int i = min(n, (int)gifInfo->frameCount) - 1; i > from; i--) {
+            memcpy_P(&start, gifInfo->frames + i, sizeof(start));
+            if (start & GIF_FRAME_KEY) {
+                from = i;
+                break;
+            }
+            start = 0;
+        }
+    }
+    if (!(cycleNo == 1 && !keyFrame && frameNo >= from && frameNo <= n)) {
+        if (start) {
+            // .kbv as a natural keyframe.  Its colour table is the global one or its own
+            keyFrame = false;
+            frameNo = from;
+            prevDisposalMethod = DISPOSAL_NONE;
+            fileSeekCallback(GIFHDRSIZE + 7);
+            parseGlobalColorTable();
+            fileSeekCallback(start & ~GIF_FRAME_KEY);
+        } else if (at >= 0) {
+            restoreKeyframe(at);
+        } else {
+            for (long i = 0; i < (long)compositeWidth * compositeHeight; i++)
+                compositeBuffer[i] = wirePixel(compositeColor);
+            keyFrame = true;
+            frameNo = 0;
+            prevDisposalMethod = DISPOSAL_NONE;
+            // .kbv the global colour table follows the header and the 7 byte screen descriptor
+            fileSeekCallback(GIFHDRSIZE + 7);
+            parseGlobalColorTable();
+        }
+        transparentColorIndex = NO_TRANSPARENT_INDEX;
+        disposalMethod = DISPOSAL_NONE;
+    }
+
+    int time = cycleTime;
+    int result = ERROR_NONE;
+    seeking = true;
+    while (result == ERROR_NONE && (keyFrame ? n > 0 : frameNo < n))
+        result = parseData();
+    seeking = false;
+    cycleTime = time;
+
+    // .kbv rows go out in place, so they are copied.  Mirrored rows are reversed
+    int w, h;
+    beginOutput();
+    keyframeArea(w, h);
+    if (w > 0 && h > 0)
+        growDirtyRect(0, 0, w, h);
+    gif_pixel_t rowBuf[maxGifWidth];
+    for (int y = 0; y < h; y++) {
+        memcpy(rowBuf, compositeBuffer + y * compositeWidth, w * sizeof(gif_pixel_t));
+        sendRow(0, y, rowBuf, w);
+    }
+    flushOutput();
+    return result;
+}
@@ -0,0 +1,878 @@
+/*
+    Animated GIFs Display Code for SmartMatrix and 32x32 RGB LED Panels
+
+    This file contains the line output stage.  Decoded lines of palette indices are
+    scaled, clipped to the viewport, trimmed, compared with the previous frame, turned
+    to the panel's orientation and sent to the display callbacks
+
+    .kbv split out of GifDecoder_Impl.h
+*/
+
+#if defined (ARDUINO)
+#include <Arduino.h>
+#elif defined (SPARK)
+#include "application.h"
+#endif
+
+#include "GifDecoder.h"
+#include "GifExpand.h"
+
+// Unchanged pixels shorter than this are sent with the changed ones rather than splitting the line
+#define DIFF_MAX_GAP    8
+
+// orient bits.  Flips happen in output coordinates, then x and y are swapped
+#define ORIENT_FLIPX    1
+#define ORIENT_FLIPY    2
+#define ORIENT_SWAPXY   4
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setOutputSize(int16_t width, int16_t height, uint8_t *boxBuf) {
+    outWidth = width;
+    outHeight = height;
+    boxRow = boxBuf;
+    boxPending = false;
+    dropCache();
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setViewport(int16_t x, int16_t y, int16_t width, int16_t height) {
+    viewX = x;
+    viewY = y;
+    viewWidth = width;
+    viewHeight = height;
+    dropCache();
+}
+
+// rotation is quarter turns clockwise.  mirrorH and mirrorV flip the panel's axes after turning.
+// Only row and block sinks are turned, so set one first.  Quarter turns also need
+// setDrawBlockCallback() and setTileBuffer().  false and unchanged if anything is missing
+// .kbv a turned column is a panel row of a few pixels.  Only blocks join them into windows
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+bool GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setOrientation(uint8_t rotation, bool mirrorH, bool mirrorV) {
+    static const uint8_t turns[4] = {
+        0, ORIENT_FLIPY | ORIENT_SWAPXY, ORIENT_FLIPX | ORIENT_FLIPY, ORIENT_FLIPX | ORIENT_SWAPXY
+    };
+    uint8_t o = turns[rotation & 3];
+    if (mirrorH) o ^= (o & ORIENT_SWAPXY) ? ORIENT_FLIPY : ORIENT_FLIPX;
+    if (mirrorV) o ^= (o & ORIENT_SWAPXY) ? ORIENT_FLIPX : ORIENT_FLIPY;
+    if (o != 0 && !hasRowSink())
+        return false;
+    if ((o & ORIENT_SWAPXY) && (tileBuf == 0 || drawBlockCallback == 0))
+        return false;
+    orient = o;
+    dropCache();
+    return true;
+}
+
+// Turned rows are collected rows at a time.  buf holds GIF_TILE_PIXELS(maxGifWidth, rows)
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setTileBuffer(gif_pixel_t *buf, int16_t rows) {
+    if (rows > ROTATE_TILE_ROWS)
+        rows = ROTATE_TILE_ROWS;
+    if (rows < 1)
+        buf = 0;
+    tileBuf = buf;
+    tileRows = buf ? rows : 0;
+    tileMask = buf ? (uint8_t *)(buf + maxGifWidth * rows) : 0;
+    if (tileMask)
+        memset(tileMask, 0, maxGifWidth);
+    tilePending = false;
+}
+
+// Map a logical screen column to the output
+// .kbv output column ox shows source column ox * lsdWidth / outWidth.  So sx starts at ceil(sx * outWidth / lsdWidth)
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::scaledX(int sx) {
+    if (outWidth <= 0 || outWidth >= lsdWidth)
+        return sx;
+    return ((int32_t)sx * outWidth + lsdWidth - 1) / lsdWidth;
+}
+
+// Map a logical screen row to the output
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::scaledY(int sy) {
+    if (outHeight <= 0 || outHeight >= lsdHeight)
+        return sy;
+    return ((int32_t)sy * outHeight + lsdHeight - 1) / lsdHeight;
+}
+
+// Logical screen column shown by output column ox
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::sourceX(int ox) {
+    if (outWidth <= 0 || outWidth >= lsdWidth)
+        return ox;
+    return (int32_t)ox * lsdWidth / outWidth;
+}
+
+// Narrow the frame's source columns x0..x1 to the viewport
+// .kbv false if no pixel of the frame can be seen
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+bool GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::frameVisible(int &x0, int &x1) {
+    if (x1 > maxGifWidth)
+        x1 = maxGifWidth;
+    if (viewWidth > 0) {
+        if (scaledY(tbiImageY + tbiHeight) <= viewY || scaledY(tbiImageY) >= viewY + viewHeight)
+            return false;
+        int sx0 = sourceX(viewX);
+        int sx1 = sourceX(viewX + viewWidth - 1) + 1 + (boxRow ? 1 : 0);  // box needs the next column too
+        if (x0 < sx0) x0 = sx0;
+        if (x1 > sx1) x1 = sx1;
+    }
+    return x0 < x1;
+}
+
+// 0: logical row y is needed.  -1: expand it but skip it.  1: it and every row after it are below the viewport
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::rowCulled(int y) {
+    int oy = scaledY(y);
+    if (boxRow && hasRowSink() && gif_format::blends && y > 0) {
+        int py = scaledY(y - 1);
+        if (py != oy && (viewWidth <= 0 || (py >= viewY && py < viewY + viewHeight)))
+            return 0;   // box partner of the kept row above
+    }
+    if (viewWidth > 0 && oy >= viewY + viewHeight)
+        return 1;
+    if (oy == scaledY(y + 1))
+        return -1;      // scaling drops this row
+    if (viewWidth > 0 && oy < viewY)
+        return -1;
+    return 0;
+}
+
+// Clip an output line to the viewport and move it to screen coordinates
+// .kbv first is how many pixels were cut off the start.  false if nothing is left
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+bool GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::clipToViewport(int &x, int &y, int &wid, int &first) {
+    first = 0;
+    if (viewWidth <= 0)
+        return wid > 0;
+    if (y < viewY || y >= viewY + viewHeight)
+        return false;
+    if (x < viewX) {
+        first = viewX - x;
+        wid -= first;
+        x = viewX;
+    }
+    if (x + wid > viewX + viewWidth)
+        wid = viewX + viewWidth - x;
+    x -= viewX;
+    y -= viewY;
+    return wid > 0;
+}
+
+// Fill a portion of the display with a color index
+// .kbv one fillRect() per disposal.  Sinks without a fill primitive get line pushes
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::fillDisplayRect(uint8_t colorIndex, int x, int y, int width, int height) {
+
+    if (recordingList())
+        listFill(colorIndex, x, y, width, height);
+    int x0 = scaledX(x), y0 = scaledY(y);
+    width = scaledX(x + width) - x0;
+    height = scaledY(y + height) - y0;
+    x = x0;
+    y = y0;
+    if (viewWidth > 0) {
+        if (x < viewX) {
+            width -= viewX - x;
+            x = viewX;
+        }
+        if (y < viewY) {
+            height -= viewY - y;
+            y = viewY;
+        }
+        if (x + width > viewX + viewWidth)
+            width = viewX + viewWidth - x;
+        if (y + height > viewY + viewHeight)
+            height = viewY + viewHeight - y;
+        x -= viewX;
+        y -= viewY;
+    }
+    // .kbv the row buffers below are maxGifWidth.  The composite is no bigger than the screen
+    if (x + width > maxGifWidth)
+        width = maxGifWidth - x;
+    if (y + height > maxGifHeight)
+        height = maxGifHeight - y;
+    if (width <= 0 || height <= 0)
+        return;
+    if (compositeBuffer && x < compositeWidth && y < compositeHeight) {
+        // .kbv only fill the part that is not already this colour.  A fill that runs off
+        //   a smaller composite updates the part it covers and is sent whole
+        gif_pixel_t color = displayPalette[colorIndex];
+        int cw = (x + width > compositeWidth) ? compositeWidth - x : width;
+        int ch = (y + height > compositeHeight) ? compositeHeight - y : height;
+        int x1 = x - 1, y1 = y - 1;
+        x0 = x + width;
+        y0 = y + height;
+        for (int yy = y; yy < ch + y; yy++) {
+            gif_pixel_t *p = compositeBuffer + yy * compositeWidth;
+            for (int xx = x; xx < cw + x; xx++) {
+                if (p[xx] != color) {
+                    p[xx] = color;
+                    if (xx < x0) x0 = xx;
+                    if (xx > x1) x1 = xx;
+                    if (yy < y0) y0 = yy;
+                    y1 = yy;
+                }
+            }
+        }
+        diffPixels += (long)width * height;
+        if (cw == width && ch == height) {
+            if (x1 < x0) {
+                diffSkipped += (long)width * height;
+                return;
+            }
+            diffSkipped += (long)width * height - (long)(x1 - x0 + 1) * (y1 - y0 + 1);
+            x = x0;
+            y = y0;
+            width = x1 - x0 + 1;
+            height = y1 - y0 + 1;
+        }
+    }
+    if (seeking)
+        return;
+    growDirtyRect(x, y, width, height);
+    if (fillRectCallback) {
+        sendFill(x, y, width, height, displayPalette[colorIndex]);
+    } else if (hasRowSink()) {
+        gif_pixel_t rowBuf[maxGifWidth];
+        for (int xx = 0; xx < width; xx++)
+            rowBuf[xx] = displayPalette[colorIndex];
+        for (int yy = y; yy < height + y; yy++)
+            sendRow(x, yy, rowBuf, width);
+    } else if (drawLineCallback && orient == 0) {
+        uint8_t lineBuf[maxGifWidth];
+        memset(lineBuf, colorIndex, width);
+        for (int yy = y; yy < height + y; yy++) {
+            (*drawLineCallback)(x, yy, lineBuf, width, displayPalette, -1);
+            if (recordingSinks())
+                cacheLine(x, yy, lineBuf, width, -1);
+        }
+    } else if (drawPixelCallback) {
+        for (int yy = y; yy < height + y; yy++) {
+            for (int xx = x; xx < width + x; xx++) {
+                sendPixel(xx, yy, colorIndex);
+            }
+        }
+    }
+}
+
+// Index of the first pixel at or after i where a and b differ
+template <typename T>
+static inline int firstDifference(const T *a, const T *b, int i, int n) {
+    while (i < n && a[i] == b[i])
+        i++;
+    return i;
+}
+
+// .kbv 16-bit pixels are compared two per 32-bit load when a and b have the same alignment
+typedef uint32_t __attribute__((__may_alias__)) uint32_alias_t;
+
+static inline int firstDifference(const uint16_t *a, const uint16_t *b, int i, int n) {
+    if ((((uintptr_t)(a + i) ^ (uintptr_t)(b + i)) & 3) == 0) {
+        if (i < n && ((uintptr_t)(a + i) & 3)) {
+            if (a[i] != b[i])
+                return i;
+            i++;
+        }
+        const uint32_alias_t *wa = (const uint32_alias_t *)(a + i);
+        const uint32_alias_t *wb = (const uint32_alias_t *)(b + i);
+        while (i + 2 <= n && *wa == *wb) {
+            wa++;
+            wb++;
+            i += 2;
+        }
+    }
+    while (i < n && a[i] == b[i])
+        i++;
+    return i;
+}
+
+// Send a decoded line to the display.  x, y are logical screen coordinates
+// .kbv scaled output drops whole source rows and only keeps the sampled columns
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::outputLine(int x, int y, uint8_t *buf, int wid, int skip) {
+
+    if (scaledX(lsdWidth) == lsdWidth && scaledY(lsdHeight) == lsdHeight) {
+        outputScaledLine(x, y, buf, wid, skip);
+        return;
+    }
+    if (boxRow && hasRowSink() && gif_format::blends) {
+        outputBoxLine(x, y, buf, wid, skip);
+        return;
+    }
+    int oy = scaledY(y);
+    if (oy == scaledY(y + 1))
+        return;
+    int ox = scaledX(x);
+    int n = scaledX(x + wid) - ox;
+    if (n == wid) {
+        outputScaledLine(ox, oy, buf, wid, skip);
+        return;
+    }
+    // .kbv step through the source columns without a divide per pixel
+    uint8_t sampled[maxGifWidth];
+    int32_t num = (int32_t)ox * lsdWidth;
+    int sx = num / outWidth - x, rem = num % outWidth;
+    int q = lsdWidth / outWidth, r = lsdWidth % outWidth;
+    for (int i = 0; i < n; i++) {
+        sampled[i] = buf[sx];
+        sx += q;
+        rem += r;
+        if (rem >= outWidth) {
+            rem -= outWidth;
+            sx++;
+        }
+    }
+    outputScaledLine(ox, oy, sampled, n, skip);
+}
+
+// .kbv leading and trailing transparent pixels are trimmed.  Empty lines are never sent
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::outputScaledLine(int x, int y, uint8_t *buf, int wid, int skip) {
+
+    int first;
+    if (!clipToViewport(x, y, wid, first))
+        return;
+    buf += first;
+    if (skip >= 0) {
+        while (wid > 0 && *buf == skip) {
+            buf++;
+            x++;
+            wid--;
+        }
+        while (wid > 0 && buf[wid - 1] == skip)
+            wid--;
+    }
+    if (wid <= 0)
+        return;
+    if (compositeBuffer && y < compositeHeight && x + wid <= compositeWidth)
+        outputChangedSpans(x, y, buf, wid, skip);
+    else
+        outputSpan(x, y, buf, wid, skip);
+}
+
+// Compare a line with the composite.  Only send the spans that have changed
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::outputChangedSpans(int x, int y, uint8_t *buf, int wid, int skip) {
+
+    // cur holds a decoded line, so it is never wider than the GIF
+    if (wid <= 0 || wid > maxGifWidth)
+        return;
+    gif_pixel_t cur[maxGifWidth] __attribute__((aligned(4)));
+    gif_pixel_t *prev = compositeBuffer + y * compositeWidth + x;
+
+    // transparent pixels keep whatever is on the screen
+    expandRow(cur, buf, wid, skip, prev);
+    diffPixels += wid;
+    if (memcmp(cur, prev, wid * sizeof(gif_pixel_t)) == 0) {
+        diffSkipped += wid;
+        return;
+    }
+    for (int i = 0; i < wid; ) {
+        i = firstDifference(cur, prev, i, wid);
+        if (i >= wid) {
+            break;
+        }
+        int start = i, end = i + 1;
+        for (i = end; i < wid && i - end < DIFF_MAX_GAP; i++) {
+            if (cur[i] != prev[i]) end = i + 1;
+        }
+        memcpy(prev + start, cur + start, (end - start) * sizeof(gif_pixel_t));
+        outputSpan(x + start, y, buf + start, end - start, skip);
+        diffSkipped -= end - start;
+        i = end;
+    }
+    diffSkipped += wid;
+}
+
+// Send a span of a line to the display
+// .kbv runs of one colour >= fillThreshold go out as fillRect().  The rest is pushed normally
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::outputSpan(int x, int y, uint8_t *buf, int wid, int skip) {
+
+    if (seeking)
+        return;
+    if (recordingList())
+        listSpan(x, y, buf, wid, skip);
+    growDirtyRect(x, y, wid, 1);
+
+    if (!hasRowSink() && (drawLineCallback == 0 || orient)) {
+        if (drawPixelCallback) {
+            for (int i = 0; i < wid; i++) {
+                uint8_t pixel = buf[i];
+                if (pixel != skip)
+                    sendPixel(x + i, y, pixel);
+            }
+        }
+        return;
+    }
+
+    int start = 0;
+    if (fillRectCallback && fillThreshold > 0 && wid >= fillThreshold) {
+        for (int i = 0; i < wid; ) {
+            uint8_t pixel = buf[i];
+            int j = i + 1;
+            while (j < wid && buf[j] == pixel) j++;
+            if (j - i >= fillThreshold && pixel != skip) {
+                if (i > start)
+                    pushSpan(x + start, y, buf + start, i - start, skip);
+                sendFill(x + i, y, j - i, 1, displayPalette[pixel]);
+                fillCount++;
+                fillBytesSaved += (j - i) * sizeof(gif_pixel_t);
+                start = j;
+            }
+            i = j;
+        }
+    }
+    if (start < wid)
+        pushSpan(x + start, y, buf + start, wid - start, skip);
+}
+
+// Palette lookup for a row.  Pair tables where the palette has one, else the vector kernel
+// .kbv on x86 PSHUFB is a faster 16 entry table than pairLut.  tools/expand_bench
+//   NEON and Helium gathers are left to gifExpand()
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::expandRow(gif_pixel_t *dst, const uint8_t *src, int n, int skip, const gif_pixel_t *under) {
+
+#if defined(GIF_PAIR_TABLES)
+    if (pairBits == 8) {
+        gifExpandPairs<8>(dst, src, n, displayPalette, pairTable, skip, under, colorCount);
+        return;
+    }
+#if defined(GIF_EXPAND_SSE41)
+    if (colorCount <= 16) {
+        gifExpandSSE41(dst, src, n, displayPalette, skip, under);
+        return;
+    }
+#elif PAIR_LUT && !defined(GIF_EXPAND_NEON) && !defined(GIF_EXPAND_HELIUM)
+    if (pairBits == 4) {
+        gifExpandPairs<4>(dst, src, n, displayPalette, pairLut, skip, under, colorCount);
+        return;
+    }
+#endif
+#endif
+    gifExpand(dst, src, n, displayPalette, skip, under);
+}
+
+// Push pixels.  Row and block sinks get each opaque run converted to display pixels
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::pushSpan(int x, int y, uint8_t *buf, int wid, int skip) {
+
+    if (!hasRowSink()) {
+        (*drawLineCallback)(x, y, buf, wid, displayPalette, skip);
+        if (recordingSinks())
+            cacheLine(x, y, buf, wid, skip);
+        return;
+    }
+    gif_pixel_t rowBuf[maxGifWidth];
+    for (int i = 0; i < wid; ) {
+        i += gifRunLength(buf + i, wid - i, skip, false);
+        int n = gifRunLength(buf + i, wid - i, skip, true);
+        if (n) {
+            expandRow(rowBuf, buf + i, n, skip);
+            sendRow(x + i, y, rowBuf, n);
+        }
+        i += n;
+    }
+}
+
+// 2x2 box filter.  Each kept source row waits for the row below it
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::outputBoxLine(int x, int y, uint8_t *buf, int wid, int skip) {
+
+    if (recordingList())
+        cacheState = GIF_CACHE_FULL;    // .kbv blended pixels are not palette indices
+    if (boxPending) {
+        boxPending = false;
+        if (y == boxY + 1 && x == boxX && wid == boxWid)
+            outputBoxPixels(boxX, boxY, boxRow, buf, boxWid, boxSkip);
+        else
+            outputBoxPixels(boxX, boxY, boxRow, 0, boxWid, boxSkip);
+    }
+    if (scaledY(y) == scaledY(y + 1))
+        return;
+    if (scaledY(lsdHeight) != lsdHeight && y + 1 < tbiImageY + tbiHeight) {
+        memcpy(boxRow, buf, wid);
+        boxPending = true;
+        boxY = y;
+        boxX = x;
+        boxWid = wid;
+        boxSkip = skip;
+    } else {
+        outputBoxPixels(x, y, buf, 0, wid, skip);
+    }
+}
+
+// Send anything still held back at the end of a frame
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::flushOutput(void) {
+
+    if (boxPending) {
+        boxPending = false;
+        outputBoxPixels(boxX, boxY, boxRow, 0, boxWid, boxSkip);
+    }
+    if (tilePending)
+        flushTile();
+    flushBlock();
+    if (orient && dirtyRect.w) {
+        int x = dirtyRect.x, y = dirtyRect.y, w = dirtyRect.w, h = dirtyRect.h;
+        if (!clipToOutput(x, y, w, h))
+            w = h = 0;
+        orientRect(x, y, w, h);
+        dirtyRect.x = x;
+        dirtyRect.y = y;
+        dirtyRect.w = w;
+        dirtyRect.h = h;
+    }
+}
+
+// Average up to 2x2 opaque source pixels for each output pixel.  Colours are already transformed
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::outputBoxPixels(int x, int y, uint8_t *row0, uint8_t *row1, int wid, int skip) {
+
+    gif_pixel_t rowBuf[maxGifWidth] __attribute__((aligned(4)));
+    uint8_t opaque[maxGifWidth];
+    int ox = scaledX(x), oy = scaledY(y);
+    int n = scaledX(x + wid) - ox;
+    int pair = (scaledX(lsdWidth) != lsdWidth);
+    int32_t num = (int32_t)ox * lsdWidth;
+    int div = (outWidth > 0 && outWidth < lsdWidth) ? outWidth : lsdWidth;
+    int sx = num / div - x, rem = num % div;
+    int q = lsdWidth / div, r = lsdWidth % div;
+    for (int i = 0; i < n; i++) {
+        uint16_t red = 0, green = 0, blue = 0, cnt = 0;
+        for (int k = 0; k < 4; k++) {
+            uint8_t *row = (k & 2) ? row1 : row0;
+            int col = sx + (k & 1);
+            if (row == 0 || ((k & 1) && (!pair || col >= wid)))
+                continue;
+            uint8_t pixel = row[col];
+            if (pixel == skip)
+                continue;
+            rgb_24 c = displayColor(pixel);
+            red += c.red;
+            green += c.green;
+            blue += c.blue;
+            cnt++;
+        }
+        opaque[i] = (cnt != 0);
+        if (cnt) {
+            red /= cnt;
+            green /= cnt;
+            blue /= cnt;
+            rowBuf[i] = wirePixel(gif_format::fromRGB(red, green, blue));
+        }
+        sx += q;
+        rem += r;
+        if (rem >= div) {
+            rem -= div;
+            sx++;
+        }
+    }
+    outputPixelRow(ox, oy, rowBuf, opaque, n);
+}
+
+// Send a line that is already display pixels.  opaque[i] == 0 marks transparent pixels
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::outputPixelRow(int x, int y, gif_pixel_t *buf, uint8_t *opaque, int wid) {
+
+    int first;
+    if (!clipToViewport(x, y, wid, first))
+        return;
+    buf += first;
+    opaque += first;
+    while (wid > 0 && *opaque == 0) {
+        buf++;
+        opaque++;
+        x++;
+        wid--;
+    }
+    while (wid > 0 && opaque[wid - 1] == 0)
+        wid--;
+    if (wid <= 0)
+        return;
+    if (compositeBuffer && y < compositeHeight && x + wid <= compositeWidth) {
+        gif_pixel_t *prev = compositeBuffer + y * compositeWidth + x;
+        for (int i = 0; i < wid; i++) {
+            if (opaque[i] == 0)
+                buf[i] = prev[i];
+        }
+        diffPixels += wid;
+        diffSkipped += wid;
+        for (int i = 0; i < wid; ) {
+            i = firstDifference(buf, prev, i, wid);
+            if (i >= wid) {
+                break;
+            }
+            int start = i, end = i + 1;
+            for (i = end; i < wid && i - end < DIFF_MAX_GAP; i++) {
+                if (buf[i] != prev[i]) end = i + 1;
+            }
+            memcpy(prev + start, buf + start, (end - start) * sizeof(gif_pixel_t));
+            growDirtyRect(x + start, y, end - start, 1);
+            sendRow(x + start, y, buf + start, end - start);
+            diffSkipped -= end - start;
+            i = end;
+        }
+        return;
+    }
+    growDirtyRect(x, y, wid, 1);
+    for (int i = 0; i < wid; ) {
+        while (i < wid && opaque[i] == 0)
+            i++;
+        int start = i;
+        while (i < wid && opaque[i])
+            i++;
+        if (i > start)
+            sendRow(x + start, y, buf + start, i - start);
+    }
+}
+
+// Called before anything of a new frame is sent
+// .kbv output size is only known once setOutputSize() and setViewport() have been called
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::beginOutput(void) {
+
+    dirtyRect.w = dirtyRect.h = 0;
+    if (viewWidth > 0) {
+        orientWidth = viewWidth;
+        orientHeight = viewHeight;
+    } else {
+        orientWidth = scaledX(lsdWidth);
+        orientHeight = scaledY(lsdHeight);
+    }
+}
+
+// Turn a rectangle of the output to the panel
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::orientRect(int &x, int &y, int &width, int &height) {
+
+    if (orient & ORIENT_FLIPX) x = orientWidth - x - width;
+    if (orient & ORIENT_FLIPY) y = orientHeight - y - height;
+    if (orient & ORIENT_SWAPXY) {
+        int t = x;
+        x = y;
+        y = t;
+        t = width;
+        width = height;
+        height = t;
+    }
+}
+
+// Clip a rectangle to the output before it is turned.  false if nothing is left
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+bool GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::clipToOutput(int &x, int &y, int &width, int &height) {
+
+    if (x + width > orientWidth) width = orientWidth - x;
+    if (y + height > orientHeight) height = orientHeight - y;
+    return width > 0 && height > 0;
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::sendFill(int x, int y, int width, int height, gif_pixel_t color) {
+
+    if (orient) {
+        if (!clipToOutput(x, y, width, height))
+            return;
+        orientRect(x, y, width, height);
+    }
+    (*fillRectCallback)(x, y, width, height, wirePixel(color));   // .kbv fill colour is always native
+    if (recordingSinks()) {
+        gif_pixel_t c = wirePixel(color);
+        cacheOp(CACHE_OP_FILL, x, y, width, height, &c);
+    }
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::sendPixel(int x, int y, uint8_t pixel) {
+
+    if (orient) {
+        int w = 1, h = 1;
+        if (!clipToOutput(x, y, w, h))
+            return;
+        orientRect(x, y, w, h);
+    }
+    rgb_24 c = displayColor(pixel);
+    (*drawPixelCallback)(x, y, c.red, c.green, c.blue);
+    if (recordingSinks())
+        cacheOp(CACHE_OP_PIXEL, x, y, 1, 1, &c);
+}
+
+// Send a row of display pixels.  Mirrored rows are reversed in buf
+// .kbv turned rows are collected in the tile and go out as columns when it is flushed
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::sendRow(int x, int y, gif_pixel_t *buf, int wid) {
+
+    if (seeking)
+        return;
+    if (orient == 0) {
+        emitRow(x, y, buf, wid);
+        return;
+    }
+    int ht = 1;
+    if (!clipToOutput(x, y, wid, ht))
+        return;
+    if ((orient & ORIENT_SWAPXY) == 0) {
+        if (orient & ORIENT_FLIPY)
+            y = orientHeight - 1 - y;
+        if (orient & ORIENT_FLIPX) {
+            x = orientWidth - x - wid;
+            for (int i = 0, j = wid - 1; i < j; i++, j--) {
+                gif_pixel_t t = buf[i];
+                buf[i] = buf[j];
+                buf[j] = t;
+            }
+        }
+        emitRow(x, y, buf, wid);
+        return;
+    }
+    if (tileBuf == 0)
+        return;     // .kbv the tile buffer was taken away after setOrientation()
+    if (x + wid > maxGifWidth)
+        wid = maxGifWidth - x;
+    if (tilePending && (y < tileY || y >= tileY + tileRows))
+        flushTile();
+    if (!tilePending) {
+        tilePending = true;
+        tileY = y - y % tileRows;
+        tileX0 = x;
+        tileX1 = x + wid;
+    }
+    if (x < tileX0) tileX0 = x;
+    if (x + wid > tileX1) tileX1 = x + wid;
+    int row = y - tileY;
+    gif_pixel_t *p = tileBuf + x * tileRows + row;
+    for (int i = 0; i < wid; i++) {
+        *p = buf[i];
+        p += tileRows;
+        tileMask[x + i] |= 1 << row;
+    }
+}
+
+// Send the tile's columns.  Each column of output is one row on the panel
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::flushTile(void) {
+
+    gif_pixel_t run[ROTATE_TILE_ROWS];
+    tilePending = false;
+    for (int n = tileX0; n < tileX1; n++) {
+        // .kbv panel rows go out top to bottom so that blocks can join them
+        int col = (orient & ORIENT_FLIPX) ? tileX1 - 1 - (n - tileX0) : n;
+        uint8_t mask = tileMask[col];
+        if (mask == 0)
+            continue;
+        tileMask[col] = 0;
+        gif_pixel_t *p = tileBuf + col * tileRows;
+        int py = (orient & ORIENT_FLIPX) ? orientWidth - 1 - col : col;
+        for (int r = 0; r < tileRows; ) {
+            if ((mask & (1 << r)) == 0) {
+                r++;
+                continue;
+            }
+            int start = r;
+            while (r < tileRows && (mask & (1 << r)))
+                r++;
+            if (orient & ORIENT_FLIPY) {
+                for (int i = 0; i < r - start; i++)
+                    run[i] = p[r - 1 - i];
+                emitRow(orientHeight - tileY - r, py, run, r - start);
+            } else {
+                emitRow(tileY + start, py, p + start, r - start);
+            }
+        }
+    }
+}
+
+// Most rows of width wid that one block may hold
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::blockLimit(int wid) {
+
+    int lines = ((long)maxGifWidth * blockRows) / wid;
+    if (blockLines > 0 && lines > blockLines)
+        lines = blockLines;
+    return lines;
+}
+
+// Send a finished row in panel coordinates
+// .kbv rows that continue the block's rectangle are packed until the line budget or the buffer is used up
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::emitRow(int x, int y, gif_pixel_t *buf, int wid) {
+
+    if (drawBlockCallback == 0) {
+        (*drawRowCallback)(x, y, buf, wid);
+        if (recordingSinks())
+            cacheOp(CACHE_OP_ROW, x, y, wid, 1, buf);
+        return;
+    }
+    if (compositeBuffer && orient == 0 && y < compositeHeight && x + wid <= compositeWidth) {
+        // .kbv the composite already holds these pixels.  Ragged rows and skipped rows join the block and are padded from it
+        if (blockHt && blockFromComposite && y >= blockY + blockHt - 1) {
+            int x0 = (x < blockX) ? x : blockX;
+            int x1 = (x + wid > blockX + blockWid) ? x + wid : blockX + blockWid;
+            int ht = y - blockY + 1;
+            long pixels = blockPixels + wid;
+            if (ht <= blockLimit(x1 - x0) && (long)(x1 - x0) * ht - pixels <= (long)DIFF_MAX_GAP * ht) {
+                blockX = x0;
+                blockWid = x1 - x0;
+                blockHt = ht;
+                blockPixels = pixels;
+                return;
+            }
+        }
+        flushBlock();
+        blockFromComposite = true;
+        blockX = x;
+        blockY = y;
+        blockWid = wid;
+        blockHt = 1;
+        blockPixels = wid;
+        return;
+    }
+    if (blockHt && (blockFromComposite || x != blockX || wid != blockWid || y != blockY + blockHt || blockHt >= blockLimit(wid)))
+        flushBlock();
+    if (blockHt == 0) {
+        blockFromComposite = false;
+        blockX = x;
+        blockY = y;
+        blockWid = wid;
+    }
+    memcpy(blockBuf + blockHt * wid, buf, wid * sizeof(gif_pixel_t));
+    blockHt++;
+}
+
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::flushBlock(void) {
+
+    if (blockHt == 0)
+        return;
+    if (blockFromComposite) {
+        for (int i = 0; i < blockHt; i++)
+            memcpy(blockBuf + i * blockWid, compositeBuffer + (blockY + i) * compositeWidth + blockX, blockWid * sizeof(gif_pixel_t));
+    }
+    (*drawBlockCallback)(blockX, blockY, blockWid, blockHt, blockBuf);
+    if (recordingSinks())
+        cacheOp(CACHE_OP_BLOCK, blockX, blockY, blockWid, blockHt, blockBuf);
+    blockHt = 0;
+}
+
+// Expand the frame's dirty rectangle to include x, y, width, height
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::growDirtyRect(int x, int y, int width, int height) {
+
+    if (dirtyRect.w == 0) {
+        dirtyRect.x = x;
+        dirtyRect.y = y;
+        dirtyRect.w = width;
+        dirtyRect.h = height;
+        return;
+    }
+    int x1 = dirtyRect.x + dirtyRect.w;
+    int y1 = dirtyRect.y + dirtyRect.h;
+    if (x < dirtyRect.x) dirtyRect.x = x;
+    if (y < dirtyRect.y) dirtyRect.y = y;
+    if (x + width > x1) x1 = x + width;
+    if (y + height > y1) y1 = y + height;
+    dirtyRect.w = x1 - dirtyRect.x;
+    dirtyRect.h = y1 - dirtyRect.y;
+}
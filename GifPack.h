@@ -0,0 +1,69 @@
+#ifndef _GIFPACK_H_
+#define _GIFPACK_H_
+
+// Many GIFs (and .GFS streams) in one file, made by tools/gifpack.cpp
+//
+// Opening a GIF by index walks the directory and does a FAT lookup for each file.
+// A pack is opened once.  Each GIF after that is a seek to its offset.  File layout,
+// little-endian:
+//   gif_pack_header
+//   count * gif_pack_entry: the table of contents
+//   the files, each starting on an align boundary
+//
+// The same pack can be a PROGMEM array (tools/gifpack -h) in place of the gifs[] table.
+// select() an entry, then give the decoder (or GifStreamPlayer) the static callbacks.
+// They read the selected entry as if it were the whole file
+
+#include "GifDecoder.h"
+
+#define GIF_PACK_MAGIC   "GPK1"
+#define GIF_PACK_NAME    28
+#define GIF_PACK_STREAM  0x0001   // a .GFS stream, not a GIF
+
+typedef struct gif_pack_header {
+    char magic[4];
+    uint16_t count;
+    uint16_t align;
+    uint32_t pad[2];
+} gif_pack_header;
+
+typedef struct gif_pack_entry {
+    char name[GIF_PACK_NAME];   // NUL terminated
+    uint32_t offset;            // from the start of the pack
+    uint32_t size;
+    int16_t width, height;      // logical screen
+    uint16_t frameCount;
+    uint16_t flags;             // GIF_PACK_xxx
+    uint32_t loopTime;          // ms
+} gif_pack_entry;
+
+class GifPack {
+public:
+    int open(file_seek_callback seek, file_read_block_callback read);  //.kbv pack in a file.  entries, or ERROR_FILENOTGIF
+    int open(const uint8_t *data);  //.kbv pack in PROGMEM
+    int getCount(void) { return header.count; }
+    bool getEntry(int index, gif_pack_entry *entry);
+    int find(const char *name);  //.kbv index.  -1 = not in the pack
+    bool select(int index);  //.kbv the callbacks read this entry from now on
+
+    static bool fileSeekCallback(unsigned long position);
+    static unsigned long filePositionCallback(void);
+    static int fileReadCallback(void);
+    static int fileReadBlockCallback(void *buffer, int numberOfBytes);
+
+private:
+    int readHeader(void);
+    bool readAt(unsigned long position, void *buffer, int numberOfBytes);
+
+    static GifPack *selected;   //.kbv the pack the callbacks read
+
+    file_seek_callback seekCallback;
+    file_read_block_callback readBlockCallback;
+    const uint8_t *data;        //.kbv PROGMEM pack.  NULL = file
+    gif_pack_header header;
+    unsigned long base;         //.kbv selected entry
+    unsigned long size;
+    unsigned long pos;          //.kbv in the entry
+};
+
+#endif
@@ -0,0 +1,115 @@
+/*
+    Animated GIFs Display Code for SmartMatrix and 32x32 RGB LED Panels
+
+    This file contains the reader for GIF packs made by tools/gifpack.cpp.  See GifPack.h
+*/
+
+#if defined (ARDUINO)
+#include <Arduino.h>
+#elif defined (SPARK)
+#include "application.h"
+#endif
+
+#include "GifPack.h"
+
+GifPack *GifPack::selected;
+
+int GifPack::open(file_seek_callback seek, file_read_block_callback read) {
+    seekCallback = seek;
+    readBlockCallback = read;
+    data = 0;
+    return readHeader();
+}
+
+int GifPack::open(const uint8_t *pack) {
+    seekCallback = 0;
+    readBlockCallback = 0;
+    data = pack;
+    return readHeader();
+}
+
+int GifPack::readHeader(void) {
+    if (selected == this)
+        selected = 0;
+    if (!readAt(0, &header, sizeof(header)) || memcmp(header.magic, GIF_PACK_MAGIC, 4) != 0) {
+        Serial.println("Not a GIF pack");
+        memset(&header, 0, sizeof(header));
+        return ERROR_FILENOTGIF;
+    }
+    return header.count;
+}
+
+bool GifPack::readAt(unsigned long position, void *buffer, int numberOfBytes) {
+    if (data) {
+        memcpy_P(buffer, data + position, numberOfBytes);
+        return true;
+    }
+    return (*seekCallback)(position) && (*readBlockCallback)(buffer, numberOfBytes) == numberOfBytes;
+}
+
+bool GifPack::getEntry(int index, gif_pack_entry *entry) {
+    if (index < 0 || index >= header.count)
+        return false;
+    return readAt(sizeof(header) + (unsigned long)index * sizeof(gif_pack_entry), entry, sizeof(gif_pack_entry));
+}
+
+int GifPack::find(const char *name) {
+    gif_pack_entry entry;
+    for (int i = 0; getEntry(i, &entry); i++) {
+        if (strncmp(entry.name, name, GIF_PACK_NAME) == 0)
+            return i;
+    }
+    return -1;
+}
+
+bool GifPack::select(int index) {
+    gif_pack_entry entry;
+    if (!getEntry(index, &entry))
+        return false;
+    base = entry.offset;
+    size = entry.size;
+    pos = 0;
+    selected = this;
+    return data || (*seekCallback)(base);
+}
+
+// File callbacks for the selected entry.  Reads stop at its end
+bool GifPack::fileSeekCallback(unsigned long position) {
+    GifPack *p = selected;
+    if (p == 0 || position > p->size)
+        return false;
+    p->pos = position;
+    return p->data || (*p->seekCallback)(p->base + position);
+}
+
+unsigned long GifPack::filePositionCallback(void) {
+    return selected ? selected->pos : 0;
+}
+
+int GifPack::fileReadCallback(void) {
+    GifPack *p = selected;
+    if (p == 0 || p->pos >= p->size)
+        return -1;
+    if (p->data)
+        return pgm_read_byte(p->data + p->base + p->pos++);
+    uint8_t b;
+    if ((*p->readBlockCallback)(&b, 1) != 1)
+        return -1;
+    p->pos++;
+    return b;
+}
+
+int GifPack::fileReadBlockCallback(void *buffer, int numberOfBytes) {
+    GifPack *p = selected;
+    if (p == 0 || p->pos >= p->size)
+        return -1;
+    if (numberOfBytes > (long)(p->size - p->pos))
+        numberOfBytes = p->size - p->pos;
+    if (p->data)
+        memcpy_P(buffer, p->data + p->base + p->pos, numberOfBytes);
+    else
+        numberOfBytes = (*p->readBlockCallback)(buffer, numberOfBytes);
+    if (numberOfBytes > 0)
+        p->pos += numberOfBytes;
+    return numberOfBytes;
+}
@@ -0,0 +1,109 @@
+#ifndef _GIFSTREAM_H_
+#define _GIFSTREAM_H_
+
+// Play-ready animation streams, made from GIFs on a PC by tools/gif2stream.cpp
+//
+// The frames are already decoded, converted to the panel's pixel format and compared with
+// the frame before, so playing one is fills and windows of pixels with large sequential
+// reads and no LZW.  File layout, little-endian:
+//   gif_stream_header, padded to align bytes
+//   intro: the whole picture at the end of a loop.  Sent once, before frame 1
+//   frames 1 to frameCount, each on an align boundary: gif_stream_frame then its ops
+//   op: gif_stream_op then
+//     GIF_STREAM_FILL    one pixel in the fill callback's order, padded to 4 bytes
+//     GIF_STREAM_PIXELS  w * h pixels in wire order (big-endian 565), padded to 4 bytes
+//
+// Reads go to two buffers in turn.  A push callback may start a DMA transfer and return.
+// Its buffer is not read into again until the wait callback has been called, or another
+// push has been started from the other buffer.  The wait callback is also called before
+// each window and fill, and at the end of the frame, while a push may still be running
+
+#include "GifDecoder.h"
+
+#define GIF_STREAM_MAGIC   "GFS1"
+#define GIF_STREAM_FILL    0
+#define GIF_STREAM_PIXELS  1
+
+typedef struct gif_stream_header {
+    char magic[4];
+    uint8_t format;         // GIF_PIXEL_FORMAT
+    uint8_t bytesPerPixel;
+    uint16_t align;         // frames start on multiples of this
+    int16_t width, height;  // area the frames cover
+    uint16_t frameCount;
+    uint16_t pad;
+    uint32_t loopTime;      // ms
+    uint32_t intro;         // file position of the intro
+    uint32_t firstFrame;    // file position of frame 1
+    uint32_t largestFrame;  // bytes
+} gif_stream_header;
+
+typedef struct gif_stream_frame {
+    uint32_t length;        // bytes to the next frame
+    uint16_t delay;         // ms
+    uint16_t ops;
+    gif_rect dirty;         // w == 0 if nothing changed
+} gif_stream_frame;
+
+typedef struct gif_stream_op {
+    uint8_t op;
+    uint8_t pad[3];
+    int16_t x, y, w, h;
+} gif_stream_op;
+
+typedef void (*window_callback)(int16_t x, int16_t y, int16_t wid, int16_t ht);
+typedef void (*push_callback)(uint8_t *bytes, int count);  // the next count bytes of pixels for the window
+
+class GifStreamPlayer {
+public:
+    void setBuffers(uint8_t *a, uint8_t *b, int size);  //.kbv size is a multiple of the stream's align, e.g. 4096
+    void setFileSeekCallback(file_seek_callback f);
+    void setFileReadBlockCallback(file_read_block_callback f);
+    void setWindowCallback(window_callback f);
+    void setPushCallback(push_callback f);
+    void setWaitCallback(callback f);  //.kbv wait for a DMA push to finish.  NULL = pushes are finished when they return
+    void setFillRectCallback(fill_callback f);
+
+    int startPlaying(void);  //.kbv ERROR_FILENOTGIF if the file is not a stream for this GIF_PIXEL_FORMAT
+    int playFrame(void);  //.kbv as decodeFrame().  ERROR_DONE_PARSING at the end of each loop
+    int getCycleNo(void) { return cycleNo; }
+    int getFrameNo(void) { return frameNo; }
+    int getFrameCount(void) { return header.frameCount; }
+    int getFrameDelay_ms(void) { return frame.delay; }
+    int getCycleTime(void) { return cycleTime; }  //.kbv ms of the loop so far
+    gif_rect getDirtyRect(void) { return frame.dirty; }
+    int16_t getWidth(void) { return header.width; }
+    int16_t getHeight(void) { return header.height; }
+
+private:
+    bool seekTo(unsigned long position);
+    void waitPushed(void);
+    bool nextBuffer(void);
+    bool readBytes(void *dst, long count);
+    bool pushBytes(long count);
+    bool skipBytes(long count);
+    int sendFrame(void);
+
+    file_seek_callback fileSeekCallback;
+    file_read_block_callback fileReadBlockCallback;
+    window_callback windowCallback;
+    push_callback pushCallback;
+    callback waitCallback;
+    fill_callback fillRectCallback;
+
+    uint8_t *buffers[2];
+    int bufferSize;
+    int current;         //.kbv buffer being read
+    int pushed;          //.kbv buffer the last push came from.  -1 = none
+    int bufferPos, bufferEnd;
+    long frameBytes;     //.kbv read from the current frame
+
+    gif_stream_header header;
+    gif_stream_frame frame;
+    bool intro;          //.kbv send the intro before the next frame
+    int cycleNo;
+    int frameNo;
+    long cycleTime;
+};
+
+#endif
@@ -0,0 +1,195 @@
+/*
+    Animated GIFs Display Code for SmartMatrix and 32x32 RGB LED Panels
+
+    This file contains the player for streams made by tools/gif2stream.cpp.  See GifStream.h
+*/
+
+#if defined (ARDUINO)
+#include <Arduino.h>
+#elif defined (SPARK)
+#include "application.h"
+#endif
+
+#include "GifStream.h"
+
+void GifStreamPlayer::setBuffers(uint8_t *a, uint8_t *b, int size) {
+    buffers[0] = a;
+    buffers[1] = b;
+    bufferSize = size;
+}
+
+void GifStreamPlayer::setFileSeekCallback(file_seek_callback f) {
+    fileSeekCallback = f;
+}
+
+void GifStreamPlayer::setFileReadBlockCallback(file_read_block_callback f) {
+    fileReadBlockCallback = f;
+}
+
+void GifStreamPlayer::setWindowCallback(window_callback f) {
+    windowCallback = f;
+}
+
+void GifStreamPlayer::setPushCallback(push_callback f) {
+    pushCallback = f;
+}
+
+void GifStreamPlayer::setWaitCallback(callback f) {
+    waitCallback = f;
+}
+
+void GifStreamPlayer::setFillRectCallback(fill_callback f) {
+    fillRectCallback = f;
+}
+
+// Reads start at position and go on in whole buffers
+bool GifStreamPlayer::seekTo(unsigned long position) {
+    bufferPos = bufferEnd = 0;
+    return (*fileSeekCallback)(position);
+}
+
+// .kbv a window, a fill or the next frame must not start while the panel still takes pixels
+void GifStreamPlayer::waitPushed(void) {
+    if (pushed == -1)
+        return;
+    if (waitCallback)
+        (*waitCallback)();
+    pushed = -1;
+}
+
+bool GifStreamPlayer::nextBuffer(void) {
+    current ^= 1;
+    if (pushed == current)
+        waitPushed();
+    int n = (*fileReadBlockCallback)(buffers[current], bufferSize);
+    if (n <= 0)
+        return false;
+    bufferPos = 0;
+    bufferEnd = n;
+    return true;
+}
+
+bool GifStreamPlayer::readBytes(void *dst, long count) {
+    uint8_t *p = (uint8_t *)dst;
+    frameBytes += count;
+    while (count > 0) {
+        if (bufferPos == bufferEnd && !nextBuffer())
+            return false;
+        int n = min(count, (long)(bufferEnd - bufferPos));
+        memcpy(p, buffers[current] + bufferPos, n);
+        bufferPos += n;
+        p += n;
+        count -= n;
+    }
+    return true;
+}
+
+// .kbv pixels go straight from the read buffer.  A window can take several pushes
+bool GifStreamPlayer::pushBytes(long count) {
+    frameBytes += count;
+    while (count > 0) {
+        if (bufferPos == bufferEnd && !nextBuffer())
+            return false;
+        int n = min(count, (long)(bufferEnd - bufferPos));
+        (*pushCallback)(buffers[current] + bufferPos, n);
+        pushed = current;
+        bufferPos += n;
+        count -= n;
+    }
+    return true;
+}
+
+bool GifStreamPlayer::skipBytes(long count) {
+    frameBytes += count;
+    while (count > 0) {
+        if (bufferPos == bufferEnd && !nextBuffer())
+            return false;
+        int n = min(count, (long)(bufferEnd - bufferPos));
+        bufferPos += n;
+        count -= n;
+    }
+    return true;
+}
+
+int GifStreamPlayer::startPlaying(void) {
+    cycleNo = 0;
+    frameNo = 0;
+    cycleTime = 0;
+    pushed = -1;
+    memset(&frame, 0, sizeof(frame));
+    memset(&header, 0, sizeof(header));
+    if (buffers[0] == 0 || buffers[1] == 0 || !seekTo(0))
+        return ERROR_FILEOPEN;
+    frameBytes = 0;
+    if (!readBytes(&header, sizeof(header)) || memcmp(header.magic, GIF_STREAM_MAGIC, 4) != 0) {
+        Serial.println("Not a GIF stream");
+        return ERROR_FILENOTGIF;
+    }
+    if (header.format != GIF_PIXEL_FORMAT || header.bytesPerPixel != sizeof(gif_pixel_t)
+            || header.align == 0 || bufferSize % header.align != 0) {
+        Serial.println("Stream is for another pixel format or buffer size");
+        return ERROR_FILENOTGIF;
+    }
+    cycleNo = 1;
+    intro = true;
+    return seekTo(header.intro) ? ERROR_NONE : ERROR_FILEOPEN;
+}
+
+// One frame from the file position.  Its padding is skipped, so the next frame follows
+int GifStreamPlayer::sendFrame(void) {
+    frameBytes = 0;
+    if (!readBytes(&frame, sizeof(frame)))
+        return ERROR_BADGIFFORMAT;
+    for (int i = 0; i < frame.ops; i++) {
+        gif_stream_op op;
+        if (!readBytes(&op, sizeof(op)))
+            return ERROR_BADGIFFORMAT;
+        long bytes = (long)op.w * op.h * sizeof(gif_pixel_t);
+        if (op.op == GIF_STREAM_FILL) {
+            gif_pixel_t color[4 / sizeof(gif_pixel_t) + 1];
+            if (!readBytes(color, (sizeof(gif_pixel_t) + 3) & ~3))
+                return ERROR_BADGIFFORMAT;
+            waitPushed();
+            if (fillRectCallback)
+                (*fillRectCallback)(op.x, op.y, op.w, op.h, color[0]);
+        } else if (op.op == GIF_STREAM_PIXELS) {
+            if (windowCallback && pushCallback) {
+                waitPushed();
+                (*windowCallback)(op.x, op.y, op.w, op.h);
+                if (!pushBytes(bytes))
+                    return ERROR_BADGIFFORMAT;
+            } else if (!skipBytes(bytes))
+                return ERROR_BADGIFFORMAT;
+            if (!skipBytes(-bytes & 3))
+                return ERROR_BADGIFFORMAT;
+        } else {
+            return ERROR_BADGIFFORMAT;
+        }
+    }
+    waitPushed();
+    if (frameBytes > (long)frame.length || !skipBytes(frame.length - frameBytes))
+        return ERROR_BADGIFFORMAT;
+    return ERROR_NONE;
+}
+
+int GifStreamPlayer::playFrame(void) {
+    if (frameNo >= header.frameCount) {
+        // .kbv like the decoder: the end of the loop is a call of its own
+        cycleNo++;
+        frameNo = 0;
+        cycleTime = 0;
+        return seekTo(header.firstFrame) ? ERROR_DONE_PARSING : ERROR_FILEOPEN;
+    }
+    if (intro) {
+        int result = sendFrame();
+        if (result != ERROR_NONE)
+            return result;
+        intro = false;
+    }
+    int result = sendFrame();
+    if (result != ERROR_NONE)
+        return result;
+    frameNo++;
+    cycleTime += frame.delay;
+    return ERROR_NONE;
+}
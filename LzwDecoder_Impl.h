@@ -37,6 +37,20 @@
 
 #include "GifDecoder.h"
 
+// .kbv the arena must stay put while any decoder is using it
+template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
+void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::setLzwArena(gif_lzw_arena *arena) {
+    if (arena) {
+        stack = arena->stack;
+        suffix = arena->suffix;
+        prefix = arena->prefix;
+    } else {
+        stack = lzwMaxBits ? stackTable : 0;
+        suffix = lzwMaxBits ? suffixTable : 0;
+        prefix = lzwMaxBits ? prefixTable : 0;
+    }
+}
+
 template <int maxGifWidth, int maxGifHeight, int lzwMaxBits>
 void GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::lzw_setTempBuffer(uint8_t * tempBuffer) {
     temp_buffer = tempBuffer;
@@ -160,7 +174,7 @@ int GifDecoder<maxGifWidth, maxGifHeight, lzwMaxBits>::lzw_decode(uint8_t *buf,
             fc = code;
             oc = c;
             if (slot >= top_slot) {
-                if (cursize < lzwMaxBits) {
+                if (cursize < lzwBits) {
                     top_slot <<= 1;
                     curmask = mask[++cursize];
                 } else {
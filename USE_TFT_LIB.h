@@ -1,6 +1,8 @@
 // 08.02.2020 added 0xF37735 for ST7735_t3
 // 08.02.2020 pushColors(... bigend) for ILI9341_due
 // 09.02.2020 SD_CS=10 for MCUFRIEND_kbv 
+// pushColors(... bigend) for RAM buffers on TFT_eSPI, Adafruit_ILI9341, Adafruit_HX8357.  big-endian is sent as is
+// FILL_MIN_RUN: shortest solid run that is cheaper as fillRect() than pushColors()
 
 #if 0
 #elif defined(STM32F1xx) && defined(BLUEPILL)
@@ -67,6 +69,7 @@ ST7789_kbv tft(0x9488, 320, 480);
 #include <MCUFRIEND_kbv.h>
 MCUFRIEND_kbv tft;
 #define SD_CS  10
+#define FILL_MIN_RUN 8          //parallel bus.  window is cheap
 
 #elif USE_TFT_LIB == 0xA7735   //repeat for 7735, 7789, 9341, ...
 #include <Adafruit_ST7735.h>
@@ -126,6 +129,11 @@ class KBVAdafruit_HX8357 : public Adafruit_HX8357
             writePixels(block, n, true, false);
             endWrite();
         }
+        void     pushColors(const uint8_t *block, int16_t n, bool first, bool bigend = false) {
+            startWrite();
+            writePixels((uint16_t *)block, n, true, bigend);
+            endWrite();
+        }
 };
 KBVAdafruit_HX8357 tft(TFT_CS, TFT_DC, TFT_RST);
 
@@ -152,6 +160,11 @@ class KBVAdafruit_ILI9341 : public Adafruit_ILI9341
             writePixels(block, n, true, false);
             endWrite();
         }
+        void     pushColors(const uint8_t *block, int16_t n, bool first, bool bigend = false) {
+            startWrite();
+            writePixels((uint16_t *)block, n, true, bigend);
+            endWrite();
+        }
 };
 KBVAdafruit_ILI9341 tft(TFT_CS, TFT_DC, TFT_RST);
 
@@ -217,8 +230,12 @@ class KBVTFT_eSPI : public TFT_eSPI
         void     pushColors(uint16_t *block, int16_t n, bool first) {
             TFT_eSPI::pushColors(block, n);
         }
+        void     pushColors(const uint8_t *block, int16_t n, bool first, bool bigend = false) {
+            TFT_eSPI::pushColors((uint16_t *)block, n, !bigend);  //big-endian needs no swap
+        }
 };
 KBVTFT_eSPI tft;
+#define FILL_MIN_RUN 32         //DMA pushColors() is already fast
 
 #elif USE_TFT_LIB == 0xF37735
 #include <ST7735_t3.h>
@@ -311,6 +328,10 @@ KBVILI9341_t3 tft(TFT_CS, TFT_DC, TFT_RST);
 #error Please specify TFT library
 #endif
 
+#ifndef FILL_MIN_RUN
+#define FILL_MIN_RUN 16         //SPI window costs about 5 pixels
+#endif
+
 
 #ifndef TFT_BLACK
 #define TFT_BLACK       0x0000      /*   0,   0,   0 */
@@ -4,5 +4,17 @@
 
 #include "GifDecoder_Impl.h"
 #include "LzwDecoder_Impl.h"
+#include "GifOutput_Impl.h"
+#include "GifCache_Impl.h"
+#include "GifKeyframe_Impl.h"
+#include "GifCompositor_Impl.h"
+#include "GifStream_Impl.h"
+#include "GifPack_Impl.h"
 
 template class GifDecoder<480, 320, 12>;   // .kbv tell the world.
+#ifndef DASHBOARD
+#define DASHBOARD 0   // .kbv must match the sketch
+#endif
+#if DASHBOARD
+template class GifCompositor<128, 128, 3>;   // .kbv layers use GifDecoder<128, 128, 0>
+#endif
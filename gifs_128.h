@@ -1,5 +1,5 @@
-// file:f:\gifs\bottom_128x128x17.gif ID    4947
-const unsigned char PROGMEM bottom_128x128x17_gif[51775] = {
+// file:bottom_128x128x17.gif made by tools/gif2header
+const unsigned char PROGMEM bottom_128x128x17_gif[51775] __attribute__((aligned(4))) = {
 0x47,0x49,0x46,0x38,0x39,0x61,0x80,0x00,0x80,0x00,0xF7,0x00,0x00,0x00,0x00,0x00,
 0x00,0x00,0x01,0x00,0xFF,0x00,0x01,0x01,0x00,0x01,0x01,0x01,0x02,0x01,0x03,0x02,
 0x02,0x00,0x03,0x03,0x00,0x03,0x04,0x00,0x05,0x05,0x00,0x05,0x05,0x03,0x05,0x06,
@@ -3238,8 +3238,15 @@ const unsigned char PROGMEM bottom_128x128x17_gif[51775] = {
 0xBA,0xAD,0xDC,0xDA,0xAD,0xDE,0xFA,0xAD,0x39,0x01,0x29,0x01,0x01,0x00,0x3B,
 
 };
-// file:f:\gifs\horse_128x96x8.gif ID   4947
-const unsigned char PROGMEM horse_128x96x8_gif[7868] = {
+const uint32_t PROGMEM bottom_128x128x17_gif_frames[17] = {
+    781, 5005, 8845, 12583, 12792, 16422, 19871, 23390,
+    26978, 30523, 30729, 34188, 37650, 41177, 44683, 48082,
+    48295,
+};
+const gif_info_t bottom_128x128x17_gif_info = { 128, 128, 17, 12, 0, 1140, bottom_128x128x17_gif_frames };
+
+// file:horse_128x96x8.gif made by tools/gif2header
+const unsigned char PROGMEM horse_128x96x8_gif[7868] __attribute__((aligned(4))) = {
 0x47,0x49,0x46,0x38,0x39,0x61,0x80,0x00,0x60,0x00,0xF3,0x00,0x00,0x00,0x00,0x00,
 0x33,0x00,0x00,0x33,0x33,0x33,0x66,0x00,0x00,0x66,0x33,0x00,0x66,0x33,0x33,0x66,
 0x66,0x66,0x66,0x99,0x99,0x99,0x99,0x99,0xCC,0xCC,0xCC,0xFF,0xFF,0xFF,0x00,0x00,
@@ -3734,8 +3741,13 @@ const unsigned char PROGMEM horse_128x96x8_gif[7868] = {
 0xB4,0xE9,0x5C,0x87,0xB3,0x4A,0xDE,0xF5,0x44,0x04,0x00,0x3B,
 
 };
-// file:f:\gifs\teakettle_128x128x10.gif ID 4947
-const unsigned char PROGMEM teakettle_128x128x10_gif[21155] = {
+const uint32_t PROGMEM horse_128x96x8_gif_frames[8] = {
+    61 | GIF_FRAME_KEY, 1089, 2023, 2966, 3966, 4964, 5953, 6932,
+};
+const gif_info_t horse_128x96x8_gif_info = { 128, 96, 8, 10, 0, 640, horse_128x96x8_gif_frames };
+
+// file:teakettle_128x128x10.gif made by tools/gif2header
+const unsigned char PROGMEM teakettle_128x128x10_gif[21155] __attribute__((aligned(4))) = {
 0x47,0x49,0x46,0x38,0x39,0x61,0x80,0x00,0x80,0x00,0xF5,0x00,0x00,0xFF,0xFF,0xFF,
 0x00,0x00,0x80,0x00,0x00,0x50,0x00,0x00,0x00,0x90,0x20,0x00,0x10,0x10,0xD0,0xB0,
 0xB0,0xB0,0x70,0x70,0x70,0xFF,0xFF,0x90,0x70,0x10,0x00,0xB0,0xC0,0xE0,0xFF,0x0F,
@@ -5061,3 +5073,8 @@ const unsigned char PROGMEM teakettle_128x128x10_gif[21155] = {
 0x08,0x00,0x3B,
 
 };
+const uint32_t PROGMEM teakettle_128x128x10_gif_frames[10] = {
+    205, 3090, 5108, 7504, 9540, 11326, 13247, 15300,
+    17215, 19145,
+};
+const gif_info_t teakettle_128x128x10_gif_info = { 128, 128, 10, 12, 0, 800, teakettle_128x128x10_gif_frames };
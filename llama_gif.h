@@ -1,5 +1,5 @@
-// file:llama_driver.gif ID	4947
-const unsigned char PROGMEM llama_driver_gif[758945] = {
+// file:llama_driver.gif made by tools/gif2header
+const unsigned char PROGMEM llama_driver_gif[758945] __attribute__((aligned(4))) = {
 0x47,0x49,0x46,0x38,0x39,0x61,0x63,0x01,0xC8,0x00,0xF7,0x00,0x00,0xE7,0x6A,0x8C,
 0xE7,0xF7,0xEF,0x9B,0xD6,0xCD,0xA8,0xD6,0xCE,0xAD,0xB6,0xB3,0x89,0xBD,0xB5,0xF9,
 0xD6,0xD1,0x6B,0x91,0x91,0xFD,0x7B,0x6C,0xD0,0xD9,0xD5,0x49,0x6E,0x74,0xFF,0x84,
@@ -47437,3 +47437,20 @@ const unsigned char PROGMEM llama_driver_gif[758945] = {
 0x3B,
 
 };
+const uint32_t PROGMEM llama_driver_gif_frames[108] = {
+    781 | GIF_FRAME_KEY, 7403, 12347, 17510, 22902, 28653, 34604, 40625,
+    46991, 53519, 60118, 66810, 73421, 80032, 86777, 93594,
+    100341, 107115, 113952, 120985, 128120, 135072, 141985, 148888,
+    155596, 162383, 169136, 176110, 183026, 190000, 196989, 203758,
+    210580, 217328, 224154, 230937, 237566, 244159, 250996, 257716,
+    264469, 271370, 278516, 285495, 292423, 299517, 306599, 313382,
+    320020, 326488, 333118, 339455, 345995, 352408, 359034, 365501,
+    372121, 378777, 385434, 391558, 398246, 406793, 413837, 421184,
+    428815, 436645, 443500, 451260, 458074, 465749, 473314, 480943,
+    487853, 495227, 502027, 509316, 516619, 524344, 532147, 540033,
+    546741, 554342, 561837, 569815, 577520, 585522, 593035, 600408,
+    608073, 615881, 623909, 631365, 639343, 646992, 654492, 661911,
+    669065, 676403, 683951, 691296, 698938, 706221, 713566, 721447,
+    729204, 736898, 744438, 751253,
+};
+const gif_info_t llama_driver_gif_info = { 355, 200, 108, 12, 0, 4320, llama_driver_gif_frames };
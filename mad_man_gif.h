@@ -1,5 +1,5 @@
-// file:AnimatedGifs_SD/data/mad_man.gif ID	4947
-const unsigned char PROGMEM mad_man_gif[711166] = {
+// file:mad_man.gif made by tools/gif2header
+const unsigned char PROGMEM mad_man_gif[711166] __attribute__((aligned(4))) = {
 0x47,0x49,0x46,0x38,0x39,0x61,0x80,0x00,0x80,0x00,0xF4,0x1B,0x00,0x4C,0x31,0x27,
 0x3D,0x47,0x49,0x2F,0x31,0x39,0x5A,0x59,0x55,0x7C,0x8C,0x99,0x1A,0x1A,0x18,0x6D,
 0x6E,0x80,0x5B,0x4E,0x32,0x95,0x71,0x78,0xBC,0xC3,0xA8,0xBF,0x63,0x3D,0x5F,0x31,
@@ -44450,3 +44450,45 @@ const unsigned char PROGMEM mad_man_gif[711166] = {
 0x8A,0xC8,0x98,0xBA,0x38,0x8D,0x7D,0x09,0x99,0x57,0x10,0x02,0x00,0x3B,
 
 };
+const uint32_t PROGMEM mad_man_gif_frames[142] = {
+    109, 5455 | GIF_FRAME_KEY, 10774 | GIF_FRAME_KEY, 15951 | GIF_FRAME_KEY,
+    21117 | GIF_FRAME_KEY, 26357 | GIF_FRAME_KEY, 31654 | GIF_FRAME_KEY, 36997 | GIF_FRAME_KEY,
+    42328 | GIF_FRAME_KEY, 47816 | GIF_FRAME_KEY, 53587 | GIF_FRAME_KEY, 59878 | GIF_FRAME_KEY,
+    65912 | GIF_FRAME_KEY, 71888 | GIF_FRAME_KEY, 77838 | GIF_FRAME_KEY, 83898 | GIF_FRAME_KEY,
+    90576 | GIF_FRAME_KEY, 97774 | GIF_FRAME_KEY, 104901 | GIF_FRAME_KEY,
+    111751 | GIF_FRAME_KEY, 118330 | GIF_FRAME_KEY, 124619 | GIF_FRAME_KEY,
+    130662 | GIF_FRAME_KEY, 136636 | GIF_FRAME_KEY, 142370 | GIF_FRAME_KEY,
+    147686 | GIF_FRAME_KEY, 152754 | GIF_FRAME_KEY, 157600 | GIF_FRAME_KEY,
+    162051 | GIF_FRAME_KEY, 166280, 170548, 174909, 179438, 183989, 188465,
+    193176, 198109, 203325, 208988 | GIF_FRAME_KEY, 214793 | GIF_FRAME_KEY,
+    220295 | GIF_FRAME_KEY, 225699 | GIF_FRAME_KEY, 230978 | GIF_FRAME_KEY,
+    236350 | GIF_FRAME_KEY, 241534, 246459 | GIF_FRAME_KEY, 251507 | GIF_FRAME_KEY,
+    256646 | GIF_FRAME_KEY, 261712 | GIF_FRAME_KEY, 266807 | GIF_FRAME_KEY,
+    271565, 275957 | GIF_FRAME_KEY, 280396 | GIF_FRAME_KEY, 284916 | GIF_FRAME_KEY,
+    289539 | GIF_FRAME_KEY, 294238 | GIF_FRAME_KEY, 298433 | GIF_FRAME_KEY,
+    302710 | GIF_FRAME_KEY, 307201 | GIF_FRAME_KEY, 312156 | GIF_FRAME_KEY,
+    317180 | GIF_FRAME_KEY, 322171 | GIF_FRAME_KEY, 326716, 331111, 336063 | GIF_FRAME_KEY,
+    341412 | GIF_FRAME_KEY, 346897 | GIF_FRAME_KEY, 352409 | GIF_FRAME_KEY,
+    357788, 362966, 368216 | GIF_FRAME_KEY, 373832 | GIF_FRAME_KEY, 379654 | GIF_FRAME_KEY,
+    385554 | GIF_FRAME_KEY, 391402 | GIF_FRAME_KEY, 397126 | GIF_FRAME_KEY,
+    402751 | GIF_FRAME_KEY, 408509 | GIF_FRAME_KEY, 414388 | GIF_FRAME_KEY,
+    420380 | GIF_FRAME_KEY, 426448 | GIF_FRAME_KEY, 432467 | GIF_FRAME_KEY,
+    438440 | GIF_FRAME_KEY, 444441 | GIF_FRAME_KEY, 450586 | GIF_FRAME_KEY,
+    456590 | GIF_FRAME_KEY, 462555 | GIF_FRAME_KEY, 468448 | GIF_FRAME_KEY,
+    474276 | GIF_FRAME_KEY, 480196 | GIF_FRAME_KEY, 485912 | GIF_FRAME_KEY,
+    491519 | GIF_FRAME_KEY, 497264 | GIF_FRAME_KEY, 503083 | GIF_FRAME_KEY,
+    509225 | GIF_FRAME_KEY, 515422 | GIF_FRAME_KEY, 521594 | GIF_FRAME_KEY,
+    527891 | GIF_FRAME_KEY, 533717 | GIF_FRAME_KEY, 539289 | GIF_FRAME_KEY,
+    545105 | GIF_FRAME_KEY, 550859 | GIF_FRAME_KEY, 556553 | GIF_FRAME_KEY,
+    562020 | GIF_FRAME_KEY, 567261 | GIF_FRAME_KEY, 572490 | GIF_FRAME_KEY,
+    577595 | GIF_FRAME_KEY, 582734 | GIF_FRAME_KEY, 587721 | GIF_FRAME_KEY,
+    592739 | GIF_FRAME_KEY, 597777 | GIF_FRAME_KEY, 602803 | GIF_FRAME_KEY,
+    607722 | GIF_FRAME_KEY, 612427 | GIF_FRAME_KEY, 617152 | GIF_FRAME_KEY,
+    621983 | GIF_FRAME_KEY, 626775 | GIF_FRAME_KEY, 631486 | GIF_FRAME_KEY,
+    636139 | GIF_FRAME_KEY, 640774 | GIF_FRAME_KEY, 645437 | GIF_FRAME_KEY,
+    650026 | GIF_FRAME_KEY, 654622 | GIF_FRAME_KEY, 659077 | GIF_FRAME_KEY,
+    663119 | GIF_FRAME_KEY, 666375, 668679, 670795, 672892, 674983, 677230,
+    679619, 682129, 684752, 687483, 690354, 693221, 696079, 698934,
+    701928, 704922, 707978,
+};
+const gif_info_t mad_man_gif_info = { 128, 128, 142, 12, 0, 2840, mad_man_gif_frames };
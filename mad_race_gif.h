@@ -1,5 +1,5 @@
-// file:AnimatedGifs_SD/data/mad_race.gif ID	4947
-const unsigned char PROGMEM mad_race_gif[173301] = {
+// file:mad_race.gif made by tools/gif2header
+const unsigned char PROGMEM mad_race_gif[173301] __attribute__((aligned(4))) = {
 0x47,0x49,0x46,0x38,0x39,0x61,0x75,0x00,0x80,0x00,0xF5,0x0E,0x00,0x90,0xE8,0x70,
 0x00,0x00,0x00,0xF8,0xE8,0x90,0xA8,0xF8,0x80,0x00,0x88,0x00,0x00,0xB8,0x20,0x00,
 0x28,0x28,0x48,0x68,0x68,0xA0,0x70,0x58,0xD0,0xA0,0x88,0xE8,0xB8,0xA0,0x70,0x90,
@@ -10834,3 +10834,21 @@ const unsigned char PROGMEM mad_race_gif[173301] = {
 0x5E,0x1A,0x04,0x00,0x3B,
 
 };
+const uint32_t PROGMEM mad_race_gif_frames[119] = {
+    205, 1062, 1946, 2917, 4076, 5296, 6530, 7736,
+    8883, 10026, 11207, 12360, 13528, 14634, 15743, 16843,
+    17987, 19230, 20509, 21805, 23074, 24372, 25757, 27201,
+    28546, 29854, 31178, 32552, 33992, 35539, 37128, 38815,
+    40581, 42386, 44273, 46177, 48083, 50039, 52106, 54239,
+    56436, 58682, 60930, 63169, 65347, 67565, 69753, 71873,
+    73893, 75905, 77870, 79841, 81849, 83717, 85541, 87447,
+    89201, 90700, 92236, 93640, 94857, 96114, 97578, 98729,
+    99773, 100788, 101913, 103130, 104590, 106124, 107695, 109210,
+    110727, 112233, 113803, 115354, 116936, 118625, 120297, 121900,
+    123529, 125132, 126732, 128310, 129903, 131583, 133183, 134773,
+    136377, 137984, 139528, 141005, 142467, 143977, 145458, 146946,
+    148420, 149905, 151358, 152748, 154186, 155575, 156929, 158219,
+    159329, 160354, 161353, 162296, 163271, 164225, 165169, 166170,
+    167163, 168152, 169155, 170113, 170999, 171834, 172576,
+};
+const gif_info_t mad_race_gif_info = { 117, 128, 119, 11, 0, 8330, mad_race_gif_frames };
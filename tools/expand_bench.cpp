@@ -0,0 +1,173 @@
+/*
+    Host benchmark for the palette expansion kernels in GifExpand.h
+
+    Every frame of the GIFs on the command line is decoded and each line the decoder
+    sends to drawLineCallback() is kept with its palette and transparent index.
+    The kernels then convert the same rows, with and without a transparent index,
+    and the times are compared with the scalar loop.
+    pairs4 only uses its table on GIFs of 16 colours or fewer.  pairs8 builds 256kB per palette
+
+    x86:     g++ -O2 -mavx2 -DARDUINO -Itools/host -I. tools/expand_bench.cpp -o expand_bench
+    AArch64: g++ -O2 -DARDUINO -Itools/host -I. tools/expand_bench.cpp -o expand_bench
+    ./expand_bench data/goose.gif data/trump.gif ...
+
+    Helium needs a Cortex-M55 target.  Time gifExpand() there with micros()
+*/
+
+#include <vector>
+#include <Arduino.h>
+#include "GifDecoder.h"
+#include "GifDecoder_Impl.h"
+#include "LzwDecoder_Impl.h"
+#include "GifOutput_Impl.h"
+#include "GifCache_Impl.h"
+#include "GifKeyframe_Impl.h"
+#include "HostFile.h"
+
+#if GIF_PIXEL_FORMAT != GIF_RGB565
+#error expand_bench times 565 pixels
+#endif
+
+struct Row {
+    uint32_t offset;  // into rowData
+    int16_t wid;
+    int16_t skip;
+    uint16_t palette;  // into palettes
+};
+
+static std::vector<uint8_t> rowData;
+static std::vector<Row> rows;
+static std::vector<uint16_t> palettes;
+static long pixelCount;
+
+GifDecoder<480, 320, 12> decoder;
+
+void drawLineCallback(int16_t x, int16_t y, uint8_t *buf, int16_t wid, uint16_t *palette, int16_t skip) {
+    size_t n = palettes.size();
+    if (n == 0 || memcmp(&palettes[n - 256], palette, 256 * sizeof(uint16_t)) != 0) {
+        palettes.insert(palettes.end(), palette, palette + 256);
+        n += 256;
+    }
+    Row r = { (uint32_t)rowData.size(), wid, skip, (uint16_t)(n / 256 - 1) };
+    rowData.insert(rowData.end(), buf, buf + wid);
+    rows.push_back(r);
+    pixelCount += wid;
+}
+
+static bool loadRows(const char *path) {
+    if (!readFile(path) || decoder.startDecoding() < 0)
+        return false;
+    int cycle = decoder.getCycleNo();
+    for (int frames = 0; decoder.getCycleNo() == cycle && frames < 1000; frames++) {
+        if (decoder.decodeFrame() < 0)
+            break;
+    }
+    return true;
+}
+
+typedef void (*expand_kernel)(uint16_t *dst, const uint8_t *src, int n, const uint16_t *palette, int skip, const uint16_t *under);
+
+static uint16_t under[480];
+static uint16_t out[480];
+
+// Convert every row.  over: transparent pixels take the under row
+static uint32_t runRows(expand_kernel kernel, bool over) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < rows.size(); i++) {
+        const Row &r = rows[i];
+        (*kernel)(out, &rowData[r.offset], r.wid, &palettes[r.palette * 256], r.skip, over ? under : 0);
+        for (int j = 0; j < r.wid; j++)
+            h = (h ^ out[j]) * 16777619u;
+    }
+    return h;
+}
+
+static double timeRows(expand_kernel kernel, bool over, int repeat) {
+    unsigned long t = micros();
+    for (int k = 0; k < repeat; k++) {
+        for (size_t i = 0; i < rows.size(); i++) {
+            const Row &r = rows[i];
+            (*kernel)(out, &rowData[r.offset], r.wid, &palettes[r.palette * 256], r.skip, over ? under : 0);
+        }
+    }
+    return (micros() - t) * 1000.0 / ((double)pixelCount * repeat);
+}
+
+static void scalarKernel(uint16_t *dst, const uint8_t *src, int n, const uint16_t *palette, int skip, const uint16_t *under) {
+    gifExpandScalar(dst, src, n, palette, skip, under);
+}
+
+static void autoKernel(uint16_t *dst, const uint8_t *src, int n, const uint16_t *palette, int skip, const uint16_t *under) {
+    gifExpand(dst, src, n, palette, skip, under);
+}
+
+// pair tables for each palette
+static std::vector<uint32_t> pairs4, pairs8;
+static const uint16_t *pairsPalette;
+
+template <int bits>
+static void pairKernel(uint16_t *dst, const uint8_t *src, int n, const uint16_t *palette, int skip, const uint16_t *under) {
+    const uint32_t *pairs = (bits == 4) ? &pairs4[0] : &pairs8[0];
+    size_t which = (palette - pairsPalette) / 256;
+    gifExpandPairs<bits>(dst, src, n, palette, pairs + (which << (2 * bits)), skip, under);
+}
+
+struct Kernel {
+    const char *name;
+    expand_kernel kernel;
+};
+
+static const Kernel kernels[] = {
+    { "scalar", scalarKernel },
+#if defined(GIF_EXPAND_SSE41)
+    { "sse4.1", gifExpandSSE41 },
+#endif
+#if defined(GIF_EXPAND_AVX2)
+    { "avx2", gifExpandAVX2 },
+#endif
+#if defined(GIF_EXPAND_NEON)
+    { "neon", gifExpandNEON },
+#endif
+#if defined(GIF_EXPAND_HELIUM)
+    { "helium", gifExpandHelium },
+#endif
+    { "pairs4", pairKernel<4> },
+    { "pairs8", pairKernel<8> },
+    { "gifExpand", autoKernel },
+};
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s file.gif ...\n", argv[0]);
+        return 1;
+    }
+    setFileCallbacks(decoder);
+    decoder.setDrawLineCallback(drawLineCallback);
+    for (int i = 1; i < argc; i++) {
+        if (!loadRows(argv[i]))
+            fprintf(stderr, "%s: can't decode\n", argv[i]);
+    }
+    if (pixelCount == 0)
+        return 1;
+    for (int i = 0; i < 480; i++)
+        under[i] = i * 0x0841;
+    int count = palettes.size() / 256;
+    pairsPalette = &palettes[0];
+    pairs4.resize(count << 8);
+    pairs8.resize(count << 16);
+    for (int i = 0; i < count; i++) {
+        gifBuildPairs<4>(&pairs4[i << 8], &palettes[i * 256]);
+        gifBuildPairs<8>(&pairs8[i << 16], &palettes[i * 256]);
+    }
+    int repeat = (int)(200000000L / pixelCount) + 1;
+    printf("%d rows, %ld pixels, %d palettes, %d passes\n", (int)rows.size(), pixelCount, (int)(palettes.size() / 256), repeat);
+    printf("%-10s %10s %10s\n", "kernel", "ns/pixel", "over");
+    uint32_t plain = runRows(scalarKernel, false), over = runRows(scalarKernel, true);
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        const Kernel &kn = kernels[k];
+        bool same = runRows(kn.kernel, false) == plain && runRows(kn.kernel, true) == over;
+        double t0 = timeRows(kn.kernel, false, repeat), t1 = timeRows(kn.kernel, true, repeat);
+        printf("%-10s %10.3f %10.3f%s\n", kn.name, t0, t1, same ? "" : "  MISMATCH");
+    }
+    return 0;
+}
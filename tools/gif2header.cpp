@@ -0,0 +1,207 @@
+/*
+    Host generator for the PROGMEM GIF headers the sketch lists in gifs[]
+
+    Each GIF is written as a hex array aligned for word reads, followed by a table of
+    frame offsets and a gif_info_t with its size, frame count, loop time and widest LZW
+    code.  The frames and the loop time come from decoding with GifDecoder.  The offsets
+    and code widths come from walking the blocks.  Offsets of frames that cover the screen
+    with no transparent pixels have GIF_FRAME_KEY set, unless the colour table they use
+    can't be known without decoding, i.e. they have none of their own and an earlier
+    frame had one.  GifDecoder::setGifInfo() lets seekToFrame() start at them.  Array names are the file names with
+    anything but letters and digits made '_', e.g. llama_driver.gif is llama_driver_gif
+
+    g++ -O2 -DARDUINO -Itools/host -I. tools/gif2header.cpp -o gif2header
+    ./gif2header [-a align] out.h in.gif ...
+      -a  array alignment.  default 4
+*/
+
+#include <vector>
+#include <string>
+#include <ctype.h>
+#include <Arduino.h>
+#include "GifDecoder.h"
+#include "GifDecoder_Impl.h"
+#include "LzwDecoder_Impl.h"
+#include "GifOutput_Impl.h"
+#include "GifCache_Impl.h"
+#include "GifKeyframe_Impl.h"
+#include "HostFile.h"
+
+GifDecoder<1024, 1024, 12> decoder;
+
+static int byteAt(size_t pos) {
+    return pos < hostFile.data.size() ? hostFile.data[pos] : -1;
+}
+
+// Widest code in the LZW data at pos.  pos is left after the terminator.  No dictionary,
+// only the count of entries that sets the code width
+static int codeWidth(size_t &pos, int minSize) {
+    int clear = 1 << minSize, width = minSize + 1, widest = width;
+    int next = clear + 2, need = width;
+    bool first = true;
+    uint32_t bits = 0;
+    int have = 0, len;
+    bool done = false;
+    while ((len = byteAt(pos)) > 0) {
+        for (size_t end = pos + 1 + len, p = pos + 1; p < end && !done; p++) {
+            bits |= (uint32_t)byteAt(p) << have;
+            have += 8;
+            while (have >= need && !done) {
+                int code = bits & ((1 << width) - 1);
+                bits >>= width;
+                have -= width;
+                if (code == clear) {
+                    width = minSize + 1;
+                    next = clear + 2;
+                    first = true;
+                } else if (code == clear + 1) {
+                    done = true;
+                } else if (first) {
+                    first = false;
+                } else if (next < 4096) {
+                    next++;
+                    if (next == (1 << width) && width < 12)
+                        width++;
+                }
+                need = width;
+                widest = max(widest, width);
+            }
+        }
+        pos += 1 + len;
+    }
+    pos++;
+    return widest;
+}
+
+static int wordAt(size_t pos) {
+    return byteAt(pos) | byteAt(pos + 1) << 8;
+}
+
+// Frame offsets, with GIF_FRAME_KEY on the ones decoding can start at, and the widest code.
+// false if the blocks don't follow on
+static bool walk(std::vector<uint32_t> &frames, int &lzwBits) {
+    if (hostFile.data.size() < 13)
+        return false;
+    int flags = hostFile.data[10];
+    int screenWidth = wordAt(6), screenHeight = wordAt(8);
+    size_t pos = 13 + ((flags & 0x80) ? 3 << ((flags & 7) + 1) : 0);
+    size_t start = pos;     // first block of the next frame
+    bool transparent = false, localSeen = false;
+    lzwBits = 0;
+    for (;;) {
+        int type = byteAt(pos);
+        if (type == 0x3B || type < 0)
+            return true;
+        if (type == 0x21) {
+            if (byteAt(pos + 1) == 0xF9 && byteAt(pos + 2) >= 4)
+                transparent = byteAt(pos + 3) & 1;
+            pos += 2;
+            int len;
+            while ((len = byteAt(pos)) > 0)
+                pos += 1 + len;
+            pos++;
+        } else if (type == 0x2C) {
+            if (pos + 10 >= hostFile.data.size())
+                return false;
+            flags = hostFile.data[pos + 9];
+            bool key = wordAt(pos + 1) == 0 && wordAt(pos + 3) == 0 && wordAt(pos + 5) >= screenWidth
+                       && wordAt(pos + 7) >= screenHeight && !transparent && ((flags & 0x80) || !localSeen);
+            localSeen |= (flags & 0x80) != 0;
+            transparent = false;
+            pos += 10 + ((flags & 0x80) ? 3 << ((flags & 7) + 1) : 0);
+            int minSize = byteAt(pos++);
+            if (minSize < 2 || minSize > 11)
+                return false;
+            frames.push_back(start | (key ? GIF_FRAME_KEY : 0));
+            int bits = codeWidth(pos, minSize);  // not inside max(), a macro
+            lzwBits = max(lzwBits, bits);
+            start = pos;
+        } else {
+            return false;
+        }
+    }
+}
+
+static std::string arrayName(const char *path) {
+    const char *name = strrchr(path, '/');
+    std::string s = name ? name + 1 : path;
+    for (size_t i = 0; i < s.size(); i++)
+        if (!isalnum((unsigned char)s[i]))
+            s[i] = '_';
+    if (isdigit((unsigned char)s[0]))
+        s = "_" + s;
+    return s;
+}
+
+int main(int argc, char **argv) {
+    int align = 4;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (argv[i][1] == 'a' && i + 1 < argc)
+            align = atoi(argv[++i]);
+    }
+    if (argc - i < 2 || align < 1 || (align & (align - 1))) {
+        fprintf(stderr, "usage: %s [-a align] out.h in.gif ...\n", argv[0]);
+        return 1;
+    }
+    const char *outName = argv[i++];
+    FILE *out = fopen(outName, "w");
+    if (out == NULL) {
+        fprintf(stderr, "%s: can't write\n", outName);
+        return 1;
+    }
+    setFileCallbacks(decoder);
+
+    int widest = 0, maxW = 0, maxH = 0;
+    for (; i < argc; i++) {
+        std::string name = arrayName(argv[i]);
+        std::vector<uint32_t> frames;
+        int lzwBits;
+        if (!readFile(argv[i]) || decoder.startDecoding() < 0 || !walk(frames, lzwBits)) {
+            fprintf(stderr, "%s: can't read or decode\n", argv[i]);
+            return 1;
+        }
+        int result, count = 0;
+        while ((result = decoder.decodeFrame()) >= ERROR_NONE && result != ERROR_DONE_PARSING) {
+            if (result == ERROR_NONE)
+                count++;
+        }
+        if (result != ERROR_DONE_PARSING || count != (int)frames.size() || count == 0) {
+            fprintf(stderr, "%s: decoded %d frames, found %d\n", argv[i], count, (int)frames.size());
+            return 1;
+        }
+        int w = decoder.getLogicalWidth(), h = decoder.getLogicalHeight();
+        long loopTime = decoder.getCycleTime();
+
+        const char *file = strrchr(argv[i], '/');
+        fprintf(out, "%s// file:%s made by tools/gif2header\n", ftell(out) ? "\n" : "", file ? file + 1 : argv[i]);
+        fprintf(out, "const unsigned char PROGMEM %s[%ld] __attribute__((aligned(%d))) = {\n",
+                name.c_str(), (long)hostFile.data.size(), align);
+        for (size_t k = 0; k < hostFile.data.size(); k++)
+            fprintf(out, "0x%02X,%s", hostFile.data[k], (k % 16 == 15 || k + 1 == hostFile.data.size()) ? "\n" : "");
+        fprintf(out, "\n};\n");
+        fprintf(out, "const uint32_t PROGMEM %s_frames[%d] = {\n", name.c_str(), count);
+        // .kbv 8 to a line, fewer if they are marked
+        for (int k = 0, n = 0, column = 0; k < count; k++) {
+            if (n == 8 || column > 72) {
+                fprintf(out, "\n");
+                n = column = 0;
+            }
+            column += fprintf(out, "%s%lu%s,", n++ ? " " : "    ", (unsigned long)(frames[k] & ~GIF_FRAME_KEY),
+                              (frames[k] & GIF_FRAME_KEY) ? " | GIF_FRAME_KEY" : "");
+        }
+        fprintf(out, "\n");
+        fprintf(out, "};\n");
+        fprintf(out, "const gif_info_t %s_info = { %d, %d, %d, %d, 0, %ld, %s_frames };\n",
+                name.c_str(), w, h, count, lzwBits, loopTime, name.c_str());
+
+        printf("%-32s %8ld bytes %4dx%-4d %4d frames %6ldms %2d bits\n", name.c_str(),
+               (long)hostFile.data.size(), w, h, count, loopTime, lzwBits);
+        widest = max(widest, lzwBits);
+        maxW = max(maxW, w);
+        maxH = max(maxH, h);
+    }
+    fclose(out);
+    printf("%s: GifDecoder<%d, %d, %d> plays them all\n", outName, maxW, maxH, widest);
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*
+    Host transcoder from a GIF to the play-ready stream of GifStream.h
+
+    The GIF is decoded with GifDecoder the way the panel would decode it, with a composite
+    so that only the pixels that change are kept.  Runs of one colour become fills.
+    Loop 1 is decoded to find the picture at the end of a loop.  That picture is the
+    intro, and loop 2 is written as the frames, so the stream loops on itself.
+    Every frame starts on an align boundary so the player reads whole sectors
+
+    g++ -O2 -DARDUINO -Itools/host -I. tools/gif2stream.cpp -o gif2stream
+    18-bit panels: add -DGIF_PIXEL_FORMAT=GIF_RGB666
+    ./gif2stream [-s WxH] [-r turns] [-t fill] [-a align] [-n] in.gif out.gfs
+      -s  shrink to fit WxH, as SCALE_TO_FIT 1
+      -r  quarter turns, as GIF_ROTATION
+      -t  shortest run sent as a fill.  default 16.  0 = no fills
+      -a  frame alignment.  default 512
+      -n  send whole frames, no comparison with the frame before
+*/
+
+#include <vector>
+#include <Arduino.h>
+#include "GifDecoder.h"
+#include "GifDecoder_Impl.h"
+#include "LzwDecoder_Impl.h"
+#include "GifOutput_Impl.h"
+#include "GifCache_Impl.h"
+#include "GifKeyframe_Impl.h"
+#include "GifStream.h"
+#include "HostFile.h"
+
+#define MAX_WIDTH  1024
+#define MAX_HEIGHT 1024
+
+GifDecoder<MAX_WIDTH, MAX_HEIGHT, 12> decoder;
+static gif_pixel_t composite[MAX_WIDTH * MAX_HEIGHT];
+static gif_pixel_t blockBuf[MAX_WIDTH * 8];
+static gif_pixel_t tileBuf[GIF_TILE_PIXELS(MAX_WIDTH, ROTATE_TILE_ROWS)];
+static gif_pixel_t screen[MAX_WIDTH * MAX_HEIGHT];  // what the panel shows.  wire order
+static std::vector<uint8_t> ops;
+static int opCount;
+static int16_t right, bottom;  // extent of everything sent
+
+static void addBytes(const void *data, long bytes) {
+    ops.insert(ops.end(), (const uint8_t *)data, (const uint8_t *)data + bytes);
+}
+
+static void padOp(void) {
+    ops.resize((ops.size() + 3) & ~3);
+}
+
+static bool addOp(uint8_t code, int16_t x, int16_t y, int16_t w, int16_t h) {
+    if (x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > MAX_WIDTH || y + h > MAX_HEIGHT)
+        return false;
+    gif_stream_op op = { code, { 0, 0, 0 }, x, y, w, h };
+    addBytes(&op, sizeof(op));
+    opCount++;
+    right = max(right, x + w);
+    bottom = max(bottom, y + h);
+    return true;
+}
+
+void fillRectCallback(int16_t x, int16_t y, int16_t w, int16_t h, gif_pixel_t color) {
+    if (!addOp(GIF_STREAM_FILL, x, y, w, h))
+        return;
+    addBytes(&color, sizeof(color));
+    padOp();
+    for (int j = y; j < y + h; j++)
+        for (int i = x; i < x + w; i++)
+            screen[j * MAX_WIDTH + i] = gif_format::swapped(color);
+}
+
+void drawBlockCallback(int16_t x, int16_t y, int16_t w, int16_t h, gif_pixel_t *buf) {
+    if (!addOp(GIF_STREAM_PIXELS, x, y, w, h))
+        return;
+    addBytes(buf, (long)w * h * sizeof(gif_pixel_t));
+    padOp();
+    for (int j = 0; j < h; j++)
+        memcpy(&screen[(y + j) * MAX_WIDTH + x], buf + j * w, w * sizeof(gif_pixel_t));
+}
+
+void drawRowCallback(int16_t x, int16_t y, gif_pixel_t *buf, int16_t w) {
+    drawBlockCallback(x, y, w, 1, buf);
+}
+
+// The frame in ops, padded to align
+static void writeFrame(FILE *out, int delay, gif_rect dirty, int align, uint32_t &largest) {
+    gif_stream_frame frame = { 0, (uint16_t)delay, (uint16_t)opCount, dirty };
+    long bytes = sizeof(frame) + ops.size();
+    frame.length = (bytes + align - 1) / align * align;
+    largest = max(largest, frame.length);
+    fwrite(&frame, sizeof(frame), 1, out);
+    fwrite(ops.data(), 1, ops.size(), out);
+    for (long i = bytes; i < (long)frame.length; i++)
+        fputc(0, out);
+    ops.clear();
+    opCount = 0;
+}
+
+// Decode to the end of the loop.  false if the GIF is broken
+static bool decodeLoop(FILE *out, int align, uint32_t &largest, uint32_t &frames) {
+    for (;;) {
+        int result = decoder.decodeFrame();
+        if (result == ERROR_DONE_PARSING)
+            return true;
+        if (result < 0)
+            return false;
+        if (out && result == ERROR_NONE) {
+            writeFrame(out, decoder.getFrameDelay_ms(), decoder.getDirtyRect(), align, largest);
+            frames++;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    int outW = 0, outH = 0, turns = 0, fill = 16, align = 512;
+    bool diff = true;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        char opt = argv[i][1];
+        if (opt == 'n') {
+            diff = false;
+            continue;
+        }
+        if (i + 1 >= argc)
+            break;
+        const char *arg = argv[++i];
+        if (opt == 's') sscanf(arg, "%dx%d", &outW, &outH);
+        else if (opt == 'r') turns = atoi(arg);
+        else if (opt == 't') fill = atoi(arg);
+        else if (opt == 'a') align = atoi(arg);
+    }
+    if (i + 2 != argc || align < 32 || (align & 3)) {
+        fprintf(stderr, "usage: %s [-s WxH] [-r turns] [-t fill] [-a align] [-n] in.gif out.gfs\n", argv[0]);
+        return 1;
+    }
+    if (!readFile(argv[i])) {
+        fprintf(stderr, "%s: can't read\n", argv[i]);
+        return 1;
+    }
+
+    setFileCallbacks(decoder);
+    decoder.setDrawRowCallback(drawRowCallback);
+    decoder.setDrawBlockCallback(drawBlockCallback, blockBuf, 8);
+    decoder.setFillRectCallback(fillRectCallback);
+    decoder.setFillThreshold(fill);
+    decoder.setWireOrder(true);
+    decoder.setTileBuffer(tileBuf, ROTATE_TILE_ROWS);
+    decoder.setOrientation(turns);
+    if (diff)
+        decoder.setCompositeBuffer(composite, gif_pixel_t());
+    if (decoder.startDecoding() < 0)
+        return 1;
+    int gw = decoder.getLogicalWidth(), gh = decoder.getLogicalHeight();
+    if (outW > 0 && outH > 0 && (gw > outW || gh > outH)) {
+        if (gw * outH > gh * outW)
+            decoder.setOutputSize(outW, gh * outW / gw);
+        else
+            decoder.setOutputSize(gw * outH / gh, outH);
+    }
+
+    // loop 1 is only decoded.  The screen it leaves is the intro
+    uint32_t largest = 0, frames = 0;
+    if (!decodeLoop(NULL, align, largest, frames)) {
+        fprintf(stderr, "%s: can't decode\n", argv[i]);
+        return 1;
+    }
+    ops.clear();
+    opCount = 0;
+    long loop1 = decoder.getCycleTime();  // the decoder's cycle time runs on over loops
+    if (right == 0 || bottom == 0) {
+        fprintf(stderr, "%s: nothing to draw.  Bigger than %dx%d?\n", argv[i], MAX_WIDTH, MAX_HEIGHT);
+        return 1;
+    }
+
+    FILE *out = fopen(argv[i + 1], "wb");
+    if (out == NULL) {
+        fprintf(stderr, "%s: can't write\n", argv[i + 1]);
+        return 1;
+    }
+    gif_stream_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GIF_STREAM_MAGIC, 4);
+    header.format = GIF_PIXEL_FORMAT;
+    header.bytesPerPixel = sizeof(gif_pixel_t);
+    header.align = align;
+    header.intro = align;
+    fwrite(&header, sizeof(header), 1, out);
+    for (long n = sizeof(header); n < align; n++)
+        fputc(0, out);
+
+    int16_t w = right, h = bottom;
+    addOp(GIF_STREAM_PIXELS, 0, 0, w, h);
+    for (int y = 0; y < h; y++)
+        addBytes(&screen[y * MAX_WIDTH], w * sizeof(gif_pixel_t));
+    padOp();
+    gif_rect all = { 0, 0, w, h };
+    writeFrame(out, 0, all, align, largest);
+    header.firstFrame = ftell(out);
+
+    if (!decodeLoop(out, align, largest, frames)) {
+        fprintf(stderr, "%s: can't decode\n", argv[i]);
+        fclose(out);
+        return 1;
+    }
+    header.width = max(w, right);
+    header.height = max(h, bottom);
+    header.frameCount = frames;
+    header.loopTime = decoder.getCycleTime() - loop1;
+    header.largestFrame = largest;
+    long total = ftell(out);
+    fseek(out, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, out);
+    fclose(out);
+
+    printf("%s: %dx%d %d frames %ldms.  GIF %ld bytes, stream %ld bytes, largest frame %ld\n",
+           argv[i], header.width, header.height, frames, (long)header.loopTime,
+           (long)hostFile.data.size(), total, (long)largest);
+    return 0;
+}
@@ -0,0 +1,508 @@
+/*
+    Host re-optimiser.  Re-encodes a GIF so that it plays cheaply on a TFT
+
+    The GIF is decoded with GifDecoder, so each frame is the screen the panel would show.
+    Frames that change nothing are merged with the frame before.  Every frame of the new
+    GIF covers the smallest rectangle holding its changed pixels.  Unchanged pixels are
+    transparent, except in a gap between two changed runs of a row that costs less to
+    push than to start a new window.  Frames leave the screen as it is (disposal 1), so
+    no frame needs the background or a restore.  One global colour table is used where
+    the frames' colours fit it.  The new GIF is decoded again and compared with the old
+    one, frame by frame, for two loops.
+
+    Predicted times per loop come from a cost model in microseconds:
+      setup  start a window, e.g. CASET RASET RAMWR on an SPI panel
+      pixel  push one pixel
+      lzw    expand one pixel of a frame rectangle
+      byte   read one byte of the file
+    The defaults are rough numbers for a 320x240 SPI panel at 40MHz and a 100MHz Cortex-M4
+    reading SD.  Time your own with micros()
+
+    g++ -O2 -DARDUINO -Itools/host -I. tools/gifopt.cpp -o gifopt
+    ./gifopt [-m setup,pixel,lzw,byte] [-b bits] in.gif out.gif
+      -m  cost model.  default 5,0.4,0.3,0.2
+      -b  longest LZW code, as lzwMaxBits in the sketch.  default 12
+*/
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <Arduino.h>
+#include "GifDecoder.h"
+#include "GifDecoder_Impl.h"
+#include "LzwDecoder_Impl.h"
+#include "GifOutput_Impl.h"
+#include "GifCache_Impl.h"
+#include "GifKeyframe_Impl.h"
+#include "HostFile.h"
+
+#define MAX_WIDTH  1024
+#define MAX_HEIGHT 1024
+#define DRAWN      0x01000000  // screen pixels are DRAWN | rgb.  0 = never drawn
+
+struct Cost {
+    double setup, pixel, lzw, byte;
+};
+
+struct Loop {
+    int frames;
+    long time;          // ms
+    long bytes;         // read from the file
+    long lzwPixels;     // in frame rectangles
+    long windows;       // opaque runs
+    long pixels;        // pushed
+    int16_t right, bottom;  // extent of everything drawn
+};
+
+struct Frame {
+    int sources;        // frames of the old GIF it stands for
+    long delay;         // 1/100 s
+    std::vector<uint32_t> colors;  // of its changed pixels
+};
+
+static uint32_t *screen;
+static Loop *loop;
+
+// two decoders, so the old and new GIFs can be compared in step
+static GifDecoder<MAX_WIDTH, MAX_HEIGHT, 12> decoders[2];
+static uint32_t screens[2][MAX_WIDTH * MAX_HEIGHT];
+
+void drawPixelCallback(int16_t x, int16_t y, uint8_t red, uint8_t green, uint8_t blue) {
+    if (x >= 0 && y >= 0 && x < MAX_WIDTH && y < MAX_HEIGHT)
+        screen[y * MAX_WIDTH + x] = DRAWN | (red << 16) | (green << 8) | blue;
+}
+
+// The sketch pushes each opaque run of a line through its own window
+void drawLineCallback(int16_t x, int16_t y, uint8_t *buf, int16_t wid, gif_pixel_t *palette, int16_t skip) {
+    loop->lzwPixels += wid;
+    for (int i = 0; i < wid; ) {
+        while (i < wid && buf[i] == skip) i++;
+        int start = i;
+        while (i < wid && buf[i] != skip) i++;
+        if (i > start) {
+            loop->windows++;
+            loop->pixels += i - start;
+            loop->right = max(loop->right, x + i);
+            loop->bottom = max(loop->bottom, y + 1);
+        }
+    }
+}
+
+static bool startSource(int d, HostFile &s, bool pixels) {
+    GifDecoder<MAX_WIDTH, MAX_HEIGHT, 12> &decoder = decoders[d];
+    hostSource = &s;
+    s.pos = 0;
+    s.bytesRead = 0;
+    setFileCallbacks(decoder);
+    decoder.setDrawPixelCallback(pixels ? drawPixelCallback : 0);
+    decoder.setDrawLineCallback(pixels ? 0 : drawLineCallback);
+    memset(screens[d], 0, sizeof(screens[d]));
+    return decoder.startDecoding() >= 0;
+}
+
+// The next frame onto screens[d].  false at the end of the loop or if the GIF is broken
+static bool nextFrame(int d, HostFile &s, int &result) {
+    hostSource = &s;
+    screen = screens[d];
+    do {
+        result = decoders[d].decodeFrame();
+    } while (result > ERROR_NONE && result != ERROR_DONE_PARSING);
+    return result == ERROR_NONE;
+}
+
+// Counts for one loop
+static bool measure(HostFile &s, Loop &l) {
+    memset(&l, 0, sizeof(l));
+    loop = &l;
+    if (!startSource(0, s, false))
+        return false;
+    int result;
+    while (nextFrame(0, s, result)) {
+        l.frames++;
+        l.time += decoders[0].getFrameDelay_ms();
+    }
+    l.bytes = s.bytesRead;
+    return result == ERROR_DONE_PARSING;
+}
+
+static void report(const char *name, const Loop &l, const Cost &c) {
+    double decode = (l.bytes * c.byte + l.lzwPixels * c.lzw) / 1000;
+    double draw = (l.windows * c.setup + l.pixels * c.pixel) / 1000;
+    printf("  %-6s %4d frames %7ld bytes %7ld windows %8ld pixels  decode %7.1fms draw %7.1fms  %s %ldms\n",
+           name, l.frames, l.bytes, l.windows, l.pixels, decode, draw,
+           decode + draw > l.time ? "slower than" : "within", l.time);
+}
+
+static bool sameScreen(const uint32_t *a, const uint32_t *b, int width, int height) {
+    for (int y = 0; y < height; y++)
+        if (memcmp(a + y * MAX_WIDTH, b + y * MAX_WIDTH, width * sizeof(uint32_t)) != 0)
+            return false;
+    return true;
+}
+
+// GIF writer
+static std::vector<uint8_t> out;
+
+static void put8(int v) { out.push_back(v); }
+static void put16(int v) { put8(v & 0xFF); put8(v >> 8); }
+
+static int tableBits(int entries) {
+    int bits = 1;
+    while ((1 << bits) < entries)
+        bits++;
+    return bits;
+}
+
+static void putTable(const std::vector<uint32_t> &colors, int bits) {
+    for (int i = 0; i < (1 << bits); i++) {
+        uint32_t c = i < (int)colors.size() ? colors[i] : 0;
+        put8(c >> 16);
+        put8(c >> 8);
+        put8(c);
+    }
+}
+
+// LZW codes packed into sub-blocks
+class LzwEncoder {
+public:
+    void encode(const uint8_t *pixels, long count, int minCodeSize, int maxBits);
+
+private:
+    void reset(void);
+    void putCode(int code);
+    void flush(void);
+
+    int minCodeSize, maxBits;
+    int clearCode;
+    int codeSize, top;
+    int slot;        // the decoder's next entry
+    int next;        // the encoder's next entry
+    bool first;      // the next code follows a clear
+    std::map<uint32_t, int> table;
+    uint32_t bits;
+    int bitCount;
+    std::vector<uint8_t> block;
+};
+
+void LzwEncoder::reset(void) {
+    codeSize = minCodeSize + 1;
+    top = 1 << codeSize;
+    slot = next = clearCode + 2;
+    first = true;
+    table.clear();
+}
+
+// .kbv code sizes follow lzw_decode(): it adds an entry for every code but the first
+// after a clear and grows once slot reaches top_slot.  The clear goes out before slot
+// reaches 1 << maxBits, so a decoder with more bits reads the same codes
+void LzwEncoder::putCode(int code) {
+    bits |= (uint32_t)code << bitCount;
+    bitCount += codeSize;
+    while (bitCount >= 8) {
+        block.push_back(bits & 0xFF);
+        bits >>= 8;
+        bitCount -= 8;
+        if (block.size() == 255)
+            flush();
+    }
+    if (code == clearCode) {
+        reset();
+        return;
+    }
+    if (!first && slot < top)
+        slot++;
+    first = false;
+    if (slot >= top && codeSize < maxBits) {
+        codeSize++;
+        top <<= 1;
+    }
+}
+
+void LzwEncoder::flush(void) {
+    if (block.empty())
+        return;
+    put8(block.size());
+    out.insert(out.end(), block.begin(), block.end());
+    block.clear();
+}
+
+void LzwEncoder::encode(const uint8_t *pixels, long count, int minCodeSize, int maxBits) {
+    this->minCodeSize = minCodeSize;
+    this->maxBits = maxBits;
+    clearCode = 1 << minCodeSize;
+    bits = 0;
+    bitCount = 0;
+    put8(minCodeSize);
+    reset();
+    putCode(clearCode);
+    int prefix = pixels[0];
+    for (long i = 1; i < count; i++) {
+        uint32_t key = (prefix << 8) | pixels[i];
+        std::map<uint32_t, int>::iterator it = table.find(key);
+        if (it != table.end()) {
+            prefix = it->second;
+            continue;
+        }
+        putCode(prefix);
+        table[key] = next++;
+        if (next == (1 << maxBits))
+            putCode(clearCode);
+        prefix = pixels[i];
+    }
+    putCode(prefix);
+    putCode(clearCode + 1);
+    if (bitCount > 0)
+        block.push_back(bits);
+    flush();
+    put8(0);
+}
+
+// Colours of the pixels that change from prev to cur, most used first
+static std::vector<uint32_t> changedColors(const uint32_t *prev, const uint32_t *cur, int width, int height) {
+    std::map<uint32_t, long> counts;
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++) {
+            uint32_t c = cur[y * MAX_WIDTH + x];
+            if (c != prev[y * MAX_WIDTH + x])
+                counts[c & 0xFFFFFF]++;
+        }
+    std::vector<std::pair<long, uint32_t> > order;
+    for (std::map<uint32_t, long>::iterator it = counts.begin(); it != counts.end(); ++it)
+        order.push_back(std::make_pair(-it->second, it->first));
+    std::sort(order.begin(), order.end());
+    std::vector<uint32_t> colors;
+    for (size_t i = 0; i < order.size(); i++)
+        colors.push_back(order[i].second);
+    return colors;
+}
+
+// One frame of the new GIF.  false if it can't be written
+static bool writeFrame(const uint32_t *prev, const uint32_t *cur, int width, int height, const Frame &f,
+                       const std::vector<uint32_t> &global, const Cost &cost, int maxBits) {
+    int x0 = width, y0 = height, x1 = -1, y1 = -1;
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            if (cur[y * MAX_WIDTH + x] != prev[y * MAX_WIDTH + x]) {
+                x0 = min(x0, x);
+                x1 = max(x1, x);
+                y0 = min(y0, y);
+                y1 = max(y1, y);
+            }
+    if (x1 < 0)
+        x0 = y0 = x1 = y1 = 0;  // a first frame that draws nothing
+    int w = x1 - x0 + 1, h = y1 - y0 + 1;
+
+    std::map<uint32_t, int> index;
+    std::vector<uint32_t> colors;
+    bool local = false;
+    for (size_t i = 0; i < f.colors.size() && !local; i++)
+        local = std::find(global.begin(), global.end(), f.colors[i]) == global.end();
+    if (local)
+        colors = f.colors;
+    else
+        colors = global;
+    for (size_t i = 0; i < colors.size(); i++)
+        index[colors[i]] = i;
+    bool transparent = f.colors.size() < 256;
+
+    // .kbv a gap is pushed when gap * pixel < setup.  It must already be drawn and its
+    // colours must fit the table.  Everything else that is unchanged is skipped
+    int longest = (int)(cost.setup / cost.pixel);
+    std::vector<uint8_t> opaque(w * h);
+    for (int y = 0; y < h; y++) {
+        const uint32_t *c = cur + (y0 + y) * MAX_WIDTH + x0, *p = prev + (y0 + y) * MAX_WIDTH + x0;
+        uint8_t *o = &opaque[y * w];
+        for (int x = 0; x < w; x++)
+            o[x] = !transparent || c[x] != p[x];
+        int last = -1;
+        for (int x = 0; x < w; x++) {
+            if (!o[x])
+                continue;
+            int gap = x - last - 1;
+            if (last >= 0 && gap > 0 && gap < longest) {
+                bool fits = true;
+                int added = 0;
+                for (int i = last + 1; i < x && fits; i++) {
+                    uint32_t rgb = c[i] & 0xFFFFFF;
+                    if (!(c[i] & DRAWN))
+                        fits = false;
+                    else if (!index.count(rgb) && !(local && colors.size() + ++added < 256))
+                        fits = false;
+                }
+                for (int i = last + 1; i < x && fits; i++) {
+                    uint32_t rgb = c[i] & 0xFFFFFF;
+                    if (!index.count(rgb)) {
+                        index[rgb] = colors.size();
+                        colors.push_back(rgb);
+                    }
+                    o[i] = 1;
+                }
+            }
+            last = x;
+        }
+    }
+    int key = colors.size();
+    std::vector<uint8_t> pixels(w * h);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++) {
+            uint32_t c = cur[(y0 + y) * MAX_WIDTH + x0 + x];
+            if (!opaque[y * w + x]) {
+                pixels[y * w + x] = key;
+            } else if (!(c & DRAWN)) {
+                fprintf(stderr, "a frame of 256 colours doesn't cover its rectangle\n");
+                return false;
+            } else {
+                pixels[y * w + x] = index[c & 0xFFFFFF];
+            }
+        }
+
+    put8(0x21);
+    put8(0xF9);
+    put8(4);
+    put8((1 << 2) | (transparent ? 1 : 0));  // leave the frame in place
+    put16(f.delay);
+    put8(transparent ? key : 0);
+    put8(0);
+
+    int bits = tableBits(colors.size() + (transparent ? 1 : 0));
+    put8(0x2C);
+    put16(x0);
+    put16(y0);
+    put16(w);
+    put16(h);
+    if (local) {
+        put8(0x80 | (bits - 1));
+        putTable(colors, bits);
+    } else {
+        put8(0);
+        bits = tableBits(global.size() + 1);
+    }
+    LzwEncoder lzw;
+    lzw.encode(&pixels[0], pixels.size(), max(bits, 2), maxBits);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Cost cost = { 5, 0.4, 0.3, 0.2 };
+    int maxBits = 12;
+    int i = 1;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        char opt = argv[i][1];
+        const char *arg = argv[i + 1];
+        if (opt == 'm') sscanf(arg, "%lf,%lf,%lf,%lf", &cost.setup, &cost.pixel, &cost.lzw, &cost.byte);
+        else if (opt == 'b') maxBits = atoi(arg);
+    }
+    if (i + 2 != argc || maxBits < 9 || maxBits > 12 || cost.pixel <= 0) {
+        fprintf(stderr, "usage: %s [-m setup,pixel,lzw,byte] [-b bits] in.gif out.gif\n", argv[0]);
+        return 1;
+    }
+    const char *inName = argv[i], *outName = argv[i + 1];
+    HostFile in;
+    if (!readFile(inName, in)) {
+        fprintf(stderr, "%s: can't read\n", inName);
+        return 1;
+    }
+    Loop before, after;
+    if (!measure(in, before) || before.frames == 0) {
+        fprintf(stderr, "%s: can't decode\n", inName);
+        return 1;
+    }
+    int lsdWidth = decoders[0].getLogicalWidth(), lsdHeight = decoders[0].getLogicalHeight();
+    int width = max(lsdWidth, before.right), height = max(lsdHeight, before.bottom);
+
+    // Pass 1: merge frames that change nothing.  Count the colours of the rest
+    std::vector<Frame> frames;
+    std::map<uint32_t, int> used;  // frames that change pixels to each colour
+    startSource(0, in, true);
+    static uint32_t prev[MAX_WIDTH * MAX_HEIGHT];
+    memset(prev, 0, sizeof(prev));
+    int result;
+    while (nextFrame(0, in, result)) {
+        int delay = decoders[0].getFrameDelay_ms() / 10;
+        if (!frames.empty() && sameScreen(prev, screens[0], width, height)) {
+            frames.back().sources++;
+            frames.back().delay = min(frames.back().delay + delay, 65535L);
+            continue;
+        }
+        Frame fr;
+        fr.sources = 1;
+        fr.delay = delay;
+        fr.colors = changedColors(prev, screens[0], width, height);
+        for (size_t c = 0; c < fr.colors.size(); c++)
+            used[fr.colors[c]]++;
+        frames.push_back(fr);
+        memcpy(prev, screens[0], sizeof(prev));
+    }
+
+    // .kbv one global table of the colours most frames use.  Frames with others get their own
+    std::vector<std::pair<int, uint32_t> > order;
+    for (std::map<uint32_t, int>::iterator it = used.begin(); it != used.end(); ++it)
+        order.push_back(std::make_pair(-it->second, it->first));
+    std::sort(order.begin(), order.end());
+    std::vector<uint32_t> global;
+    for (size_t c = 0; c < order.size() && c < 255; c++)
+        global.push_back(order[c].second);
+
+    // Pass 2: write
+    int globalBits = tableBits(global.size() + 1);
+    out.clear();
+    out.insert(out.end(), (const uint8_t *)"GIF89a", (const uint8_t *)"GIF89a" + 6);
+    put16(width);
+    put16(height);
+    put8(0x80 | ((globalBits - 1) << 4) | (globalBits - 1));
+    put8(0);
+    put8(0);
+    putTable(global, globalBits);
+    put8(0x21);
+    put8(0xFF);
+    put8(11);
+    out.insert(out.end(), (const uint8_t *)"NETSCAPE2.0", (const uint8_t *)"NETSCAPE2.0" + 11);
+    put8(3);
+    put8(1);
+    put16(0);  // loop for ever
+    put8(0);
+    startSource(0, in, true);
+    memset(prev, 0, sizeof(prev));
+    for (size_t k = 0; k < frames.size(); k++) {
+        for (int n = 0; n < frames[k].sources; n++)
+            nextFrame(0, in, result);
+        if (!writeFrame(prev, screens[0], width, height, frames[k], global, cost, maxBits)) {
+            fprintf(stderr, "%s: frame %d can't be written\n", inName, (int)k + 1);
+            return 1;
+        }
+        memcpy(prev, screens[0], sizeof(prev));
+    }
+    put8(0x3B);
+
+    // Check: two loops of both GIFs in step, compared at the end of each new frame
+    HostFile opt;
+    opt.data = out;
+    bool same = startSource(0, in, true) && startSource(1, opt, true);
+    for (int pass = 0; pass < 2 && same; pass++) {
+        int r0, r1;
+        for (size_t k = 0; k < frames.size() && same; k++) {
+            for (int n = 0; n < frames[k].sources; n++)
+                same = same && nextFrame(0, in, r0);
+            same = same && nextFrame(1, opt, r1) && decoders[0].getCycleTime() == decoders[1].getCycleTime()
+                   && sameScreen(screens[0], screens[1], width, height);
+        }
+        same = same && !nextFrame(0, in, r0) && r0 == ERROR_DONE_PARSING
+               && !nextFrame(1, opt, r1) && r1 == ERROR_DONE_PARSING;
+    }
+    if (!same) {
+        fprintf(stderr, "%s: the new GIF doesn't match.  Not written\n", inName);
+        return 1;
+    }
+    measure(opt, after);
+
+    FILE *o = fopen(outName, "wb");
+    if (o == NULL || fwrite(&out[0], 1, out.size(), o) != out.size()) {
+        fprintf(stderr, "%s: can't write\n", outName);
+        return 1;
+    }
+    fclose(o);
+    printf("%s: %dx%d %ld bytes -> %ld bytes\n", inName, width, height, (long)in.data.size(), (long)out.size());
+    report("before", before, cost);
+    report("after", after, cost);
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*
+    Host packer for the GIF packs of GifPack.h
+
+    Each GIF is decoded once with GifDecoder for its size, frame count and loop time.
+    .GFS streams from tools/gif2stream are stored with the numbers from their header.
+    Names are the file names without the path.  Every file starts on an align boundary
+
+    g++ -O2 -DARDUINO -Itools/host -I. tools/gifpack.cpp -o gifpack
+    ./gifpack [-a align] [-h] out.gpk in.gif ...
+      -a  file alignment.  default 512, the SD sector.  -h defaults to 4
+      -h  write a header of one PROGMEM array, gif_pack[], for the sketch's GIF_PACK 2
+*/
+
+#include <vector>
+#include <string>
+#include <Arduino.h>
+#include "GifDecoder.h"
+#include "GifDecoder_Impl.h"
+#include "LzwDecoder_Impl.h"
+#include "GifOutput_Impl.h"
+#include "GifCache_Impl.h"
+#include "GifKeyframe_Impl.h"
+#include "GifStream.h"
+#include "GifPack.h"
+#include "HostFile.h"
+
+GifDecoder<1024, 1024, 12> decoder;
+
+// Size, frames and loop time of the file in hostFile
+static bool probe(gif_pack_entry &e) {
+    if (hostFile.data.size() >= sizeof(gif_stream_header) && memcmp(&hostFile.data[0], GIF_STREAM_MAGIC, 4) == 0) {
+        gif_stream_header h;
+        memcpy(&h, &hostFile.data[0], sizeof(h));
+        e.width = h.width;
+        e.height = h.height;
+        e.frameCount = h.frameCount;
+        e.loopTime = h.loopTime;
+        e.flags = GIF_PACK_STREAM;
+        return true;
+    }
+    hostFile.pos = 0;
+    if (decoder.startDecoding() < 0)
+        return false;
+    e.width = decoder.getLogicalWidth();
+    e.height = decoder.getLogicalHeight();
+    int result, frames = 0;
+    while ((result = decoder.decodeFrame()) >= ERROR_NONE && result != ERROR_DONE_PARSING) {
+        if (result == ERROR_NONE)
+            frames++;
+    }
+    e.frameCount = frames;
+    e.loopTime = decoder.getCycleTime();
+    return result == ERROR_DONE_PARSING && frames > 0;
+}
+
+int main(int argc, char **argv) {
+    int align = 0;
+    bool header = false;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (argv[i][1] == 'h')
+            header = true;
+        else if (argv[i][1] == 'a' && i + 1 < argc)
+            align = atoi(argv[++i]);
+    }
+    if (align == 0)
+        align = header ? 4 : 512;
+    int count = argc - i - 1;
+    if (count < 1 || count > 65535 || align < 1) {
+        fprintf(stderr, "usage: %s [-a align] [-h] out.gpk in.gif ...\n", argv[0]);
+        return 1;
+    }
+    const char *outName = argv[i++];
+    setFileCallbacks(decoder);
+
+    gif_pack_header head;
+    memset(&head, 0, sizeof(head));
+    memcpy(head.magic, GIF_PACK_MAGIC, 4);
+    head.count = count;
+    head.align = align;
+    std::vector<gif_pack_entry> toc(count);
+    std::vector<uint8_t> pack(sizeof(head) + count * sizeof(gif_pack_entry));
+    for (int n = 0; n < count; n++, i++) {
+        gif_pack_entry &e = toc[n];
+        memset(&e, 0, sizeof(e));
+        const char *name = strrchr(argv[i], '/');
+        name = name ? name + 1 : argv[i];
+        if (strlen(name) >= GIF_PACK_NAME) {
+            fprintf(stderr, "%s: name longer than %d\n", argv[i], GIF_PACK_NAME - 1);
+            return 1;
+        }
+        if (!readFile(argv[i]) || !probe(e)) {
+            fprintf(stderr, "%s: can't read or decode\n", argv[i]);
+            return 1;
+        }
+        strcpy(e.name, name);
+        pack.resize((pack.size() + align - 1) / align * align);
+        e.offset = pack.size();
+        e.size = hostFile.data.size();
+        pack.insert(pack.end(), hostFile.data.begin(), hostFile.data.end());
+        printf("%3d: %-27s %8ld bytes @%-8ld %4dx%-4d %4d frames %6ldms%s\n", n + 1, e.name, (long)e.size,
+               (long)e.offset, e.width, e.height, e.frameCount, (long)e.loopTime, e.flags & GIF_PACK_STREAM ? " stream" : "");
+    }
+    memcpy(&pack[0], &head, sizeof(head));
+    memcpy(&pack[sizeof(head)], &toc[0], count * sizeof(gif_pack_entry));
+
+    FILE *out = fopen(outName, header ? "w" : "wb");
+    if (out == NULL) {
+        fprintf(stderr, "%s: can't write\n", outName);
+        return 1;
+    }
+    if (header) {
+        fprintf(out, "// made by tools/gifpack.  %d files\n", count);
+        for (int n = 0; n < count; n++)
+            fprintf(out, "//   %s\n", toc[n].name);
+        fprintf(out, "const unsigned char PROGMEM gif_pack[%ld] = {\n", (long)pack.size());
+        for (size_t k = 0; k < pack.size(); k++)
+            fprintf(out, "0x%02X,%s", pack[k], (k % 16 == 15 || k + 1 == pack.size()) ? "\n" : "");
+        fprintf(out, "};\n");
+    } else {
+        fwrite(&pack[0], 1, pack.size(), out);
+    }
+    fclose(out);
+    printf("%s: %d files, %ld bytes\n", outName, count, (long)pack.size());
+    return 0;
+}
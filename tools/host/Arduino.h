@@ -0,0 +1,49 @@
+// Just enough of Arduino.h to build the decoder on a PC for the tools in this folder
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define HEX 16
+#define DEC 10
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define memcpy_P memcpy
+
+#ifndef min
+#define min(a, b) (((a) <= (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) (((a) >= (b)) ? (a) : (b))
+#endif
+
+// Serial goes to stderr
+struct HostSerial {
+    void begin(long) {}
+    operator bool() { return true; }
+    void print(const char *s) { fputs(s, stderr); }
+    void print(long v, int b = DEC) { fprintf(stderr, b == HEX ? "%lx" : "%ld", v); }
+    void print(int v, int b = DEC) { print((long)v, b); }
+    void print(unsigned long v, int b = DEC) { print((long)v, b); }
+    void print(unsigned int v, int b = DEC) { print((long)v, b); }
+    void println(void) { fputs("\n", stderr); }
+    template <class T> void println(T v) { print(v); println(); }
+    template <class T> void println(T v, int b) { print(v, b); println(); }
+    int read() { return -1; }
+};
+static HostSerial Serial;
+
+static inline unsigned long micros(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+static inline unsigned long millis(void) { return micros() / 1000; }
+static inline void yield(void) {}
+static inline void delay(unsigned long) {}
+
+#endif
@@ -0,0 +1,60 @@
+// A file read into memory and the decoder's file callbacks over it, for the tools in this folder
+#ifndef _HOST_FILE_H_
+#define _HOST_FILE_H_
+
+#include <vector>
+#include <Arduino.h>
+
+struct HostFile {
+    std::vector<uint8_t> data;
+    unsigned long pos;
+    long bytesRead;     // through the callbacks
+};
+
+static HostFile hostFile;                   // one file at a time
+static HostFile *hostSource = &hostFile;    // the file the callbacks read
+
+// The whole file.  false if it can't be read or is empty
+static bool readFile(const char *path, HostFile &file = hostFile) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    file.data.resize(size > 0 ? size : 0);
+    size_t got = size > 0 ? fread(&file.data[0], 1, file.data.size(), f) : 0;
+    fclose(f);
+    file.pos = 0;
+    file.bytesRead = 0;
+    return got == file.data.size() && got > 0;
+}
+
+bool fileSeekCallback(unsigned long position) { hostSource->pos = position; return true; }
+unsigned long filePositionCallback(void) { return hostSource->pos; }
+int fileReadCallback(void) {
+    if (hostSource->pos >= hostSource->data.size())
+        return -1;
+    hostSource->bytesRead++;
+    return hostSource->data[hostSource->pos++];
+}
+int fileReadBlockCallback(void *buffer, int numberOfBytes) {
+    if (hostSource->pos >= hostSource->data.size())
+        return -1;
+    if (hostSource->pos + numberOfBytes > hostSource->data.size())
+        numberOfBytes = hostSource->data.size() - hostSource->pos;
+    memcpy(buffer, &hostSource->data[hostSource->pos], numberOfBytes);
+    hostSource->pos += numberOfBytes;
+    hostSource->bytesRead += numberOfBytes;
+    return numberOfBytes;
+}
+
+template <class Decoder>
+static void setFileCallbacks(Decoder &decoder) {
+    decoder.setFileSeekCallback(fileSeekCallback);
+    decoder.setFilePositionCallback(filePositionCallback);
+    decoder.setFileReadCallback(fileReadCallback);
+    decoder.setFileReadBlockCallback(fileReadBlockCallback);
+}
+
+#endif
@@ -1,5 +1,5 @@
-// file:irish_cows_green_beer.gif ID    4947
-const unsigned char PROGMEM irish_cows_green_beer_gif[29798] = {
+// file:irish_cows_green_beer.gif made by tools/gif2header
+const unsigned char PROGMEM irish_cows_green_beer_gif[29798] __attribute__((aligned(4))) = {
 0x47,0x49,0x46,0x38,0x39,0x61,0x91,0x01,0x9D,0x00,0xB3,0x0F,0x00,0xFF,0xFF,0xFF,
 0x00,0x86,0x29,0x00,0x00,0x00,0x86,0x86,0x86,0x20,0x20,0x20,0xAD,0xB4,0xB9,0x37,
 0x46,0x37,0xC0,0xFF,0xC0,0x5C,0x59,0x50,0x80,0x7F,0x5F,0x3A,0x96,0x36,0xCF,0xAB,
@@ -1865,8 +1865,13 @@ const unsigned char PROGMEM irish_cows_green_beer_gif[29798] = {
 0xBE,0xE1,0x8D,0x00,0x00,0x3B,
 
 };
-// file:globe_rotating.gif ID   4947
-const unsigned char PROGMEM globe_rotating_gif[90533] = {
+const uint32_t PROGMEM irish_cows_green_beer_gif_frames[4] = {
+    61, 7729, 15242, 22284,
+};
+const gif_info_t irish_cows_green_beer_gif_info = { 401, 157, 4, 12, 0, 1600, irish_cows_green_beer_gif_frames };
+
+// file:globe_rotating.gif made by tools/gif2header
+const unsigned char PROGMEM globe_rotating_gif[90533] __attribute__((aligned(4))) = {
 0x47,0x49,0x46,0x38,0x39,0x61,0xAA,0x00,0xAA,0x00,0xD7,0x00,0x00,0xFF,0xFF,0xFF,
 0x04,0x00,0x00,0x0C,0x00,0x00,0x10,0x00,0x00,0x14,0x00,0x00,0x18,0x00,0x00,0x1C,
 0x00,0x00,0x18,0x04,0x04,0x24,0x00,0x00,0x14,0x08,0x08,0x28,0x00,0x00,0x2C,0x00,
@@ -7528,4 +7533,10 @@ const unsigned char PROGMEM globe_rotating_gif[90533] = {
 0xB0,0x01,0x01,0x00,0x3B,
 
 };
-
+const uint32_t PROGMEM globe_rotating_gif_frames[30] = {
+    781, 4873, 8603, 12187, 15720, 19127, 22420, 25459,
+    28357, 31053, 33577, 35972, 38274, 40480, 42663, 44663,
+    46733, 48845, 51011, 53228, 55534, 58197, 61204, 64518,
+    68007, 71683, 75491, 79245, 82993, 86806,
+};
+const gif_info_t globe_rotating_gif_info = { 170, 170, 30, 12, 0, 3300, globe_rotating_gif_frames };